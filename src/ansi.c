@@ -0,0 +1,120 @@
+/* ansi.c - Cells of the screen as ANSI escape sequences.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+
+#include "ansi.h"
+
+/* Write the SGR parameters of color c, either as a foreground (base 30)
+   or as a background (base 40). */
+
+static int put_color (char *sgr, short c, int base)
+{
+  if (c < 0)
+    return 0;			/* The default, as reset. */
+  if (c < 8)
+    return sprintf (sgr, ";%d", base + c);
+  if (c < 16)
+    return sprintf (sgr, ";%d", base + 60 + c - 8);
+  return sprintf (sgr, ";%d;5;%d", base + 8, c);
+}
+
+/* Write the escape sequence which sets attrs and pair. */
+
+static int put_pen (char *sgr, attr_t attrs, short pair)
+{
+  short fg, bg;
+  int n;
+
+  n = sprintf (sgr, "\033[0");
+  if (attrs & A_BOLD)
+    n += sprintf (sgr + n, ";1");
+  if (attrs & A_DIM)
+    n += sprintf (sgr + n, ";2");
+  if (attrs & A_UNDERLINE)
+    n += sprintf (sgr + n, ";4");
+  if (attrs & A_BLINK)
+    n += sprintf (sgr + n, ";5");
+  if (attrs & A_REVERSE)
+    n += sprintf (sgr + n, ";7");
+  if (pair > 0 && pair_content (pair, &fg, &bg) == OK)
+    {
+      n += put_color (sgr + n, fg, 30);
+      n += put_color (sgr + n, bg, 40);
+    }
+  n += sprintf (sgr + n, "m");
+  return n;
+}
+
+/* Write character c as UTF-8. */
+
+static int put_char (char *utf8, wchar_t c)
+{
+  if (c < 0x80)
+    {
+      utf8[0] = c;
+      return 1;
+    }
+  if (c < 0x800)
+    {
+      utf8[0] = 0xc0 | (c >> 6);
+      utf8[1] = 0x80 | (c & 0x3f);
+      return 2;
+    }
+  if (c < 0x10000)
+    {
+      utf8[0] = 0xe0 | (c >> 12);
+      utf8[1] = 0x80 | ((c >> 6) & 0x3f);
+      utf8[2] = 0x80 | (c & 0x3f);
+      return 3;
+    }
+  utf8[0] = 0xf0 | ((c >> 18) & 0x07);
+  utf8[1] = 0x80 | ((c >> 12) & 0x3f);
+  utf8[2] = 0x80 | ((c >> 6) & 0x3f);
+  utf8[3] = 0x80 | (c & 0x3f);
+  return 4;
+}
+
+int ansi_move (char *out, int y, int x)
+{
+  return sprintf (out, "\033[%d;%dH", y + 1, x + 1);
+}
+
+int ansi_cell (char *out, const cchar_t *cell, attr_t *attrs, short *pair)
+{
+  wchar_t chars[CCHARW_MAX + 1];
+  attr_t cell_attrs;
+  short cell_pair;
+  int i, n = 0;
+
+  getcchar (cell, chars, &cell_attrs, &cell_pair, NULL);
+  if (cell_attrs != *attrs || cell_pair != *pair)
+    {
+      n += put_pen (out, cell_attrs, cell_pair);
+      *attrs = cell_attrs;
+      *pair = cell_pair;
+    }
+
+  if (!chars[0])
+    n += put_char (out + n, ' ');
+  for (i = 0; chars[i]; i++)
+    n += put_char (out + n, chars[i]);
+  return n;
+}
@@ -0,0 +1,59 @@
+/* ansi.h - Cells of the screen as ANSI escape sequences.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANSI_H
+#define ANSI_H
+
+#ifndef NCURSES_WIDECHAR
+#define NCURSES_WIDECHAR 1	/* Cells are wide characters. */
+#endif
+#include <ncurses.h>
+
+/* Where the screen has to reach a terminal by other means than ncurses
+   (a recording, or a hosted game), the cells ncurses holds are sent as
+   ECMA-48 (ANSI) sequences and UTF-8, as about every terminal of today
+   takes them, whatever its terminfo entry. */
+
+#define ANSI_CELL_MAX 96	/* Most a cell may take (moves, colors and
+				   characters included). */
+
+/* Hide the cursor, reset the attributes and clear the screen. */
+
+#define ANSI_CLEAR "\033[?25l\033[0m\033[H\033[2J"
+
+/* Switch to the terminal's alternate screen, and back to the main one,
+   with the cursor shown. */
+
+#define ANSI_ENTER "\033[?1049h"
+#define ANSI_LEAVE "\033[0m\033[?25h\033[?1049l"
+
+/* Write to out the sequence which moves the cursor to row y and column
+   x, counted from 0. Return its length. */
+
+int ansi_move (char *out, int y, int x);
+
+/* Write to out the sequence which draws cell where the cursor is, given
+   the attributes and color pair which the terminal writes with; those are
+   updated. Colors are looked up with pair_content, on the current screen.
+   Return its length. */
+
+int ansi_cell (char *out, const cchar_t *cell, attr_t *attrs, short *pair);
+
+#endif /* ANSI_H */
@@ -0,0 +1,142 @@
+/* arena.c - Memory for the game.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#define _DEFAULT_SOURCE		/* For MAP_ANONYMOUS and MAP_NORESERVE. */
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <config.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 16		/* Alignment of carved objects. */
+
+int arena_init (arena_t *arena, size_t size)
+{
+  arena->base = malloc (size);
+  arena->size = arena->base ? size : 0;
+  arena->used = 0;
+  arena->reserved = 0;
+  return arena->base ? 0 : -1;
+}
+
+int arena_reserve (arena_t *arena, size_t size)
+{
+  void *base;
+
+  base = mmap (NULL, size, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  arena->base = base == MAP_FAILED ? NULL : base;
+  arena->size = arena->base ? size : 0;
+  arena->used = 0;
+  arena->reserved = 1;
+  return arena->base ? 0 : -1;
+}
+
+void *arena_alloc (arena_t *arena, size_t size)
+{
+  void *p;
+
+  size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+  if (size > arena->size - arena->used)
+    return NULL;
+
+  p = arena->base + arena->used;
+  arena->used += size;
+  return p;
+}
+
+void arena_reset (arena_t *arena)
+{
+  if (arena->reserved && arena->used)
+    madvise (arena->base, arena->used, MADV_DONTNEED); /* Give pages back. */
+  arena->used = 0;
+}
+
+void arena_free (arena_t *arena)
+{
+  if (arena->reserved)
+    munmap (arena->base, arena->size);
+  else
+    free (arena->base);
+  arena->base = NULL;
+  arena->size = arena->used = 0;
+}
+
+#ifdef ALLOC_CHECK
+
+/* Count the heap calls by interposing the allocator functions, which then
+   hand over to the C library's own. Only calls made by the game's own code
+   are counted: the libraries allocate now and then on first use of
+   something (ncurses, for one, caches escape sequences as it meets them),
+   which doesn't grow with time. Other ways in (memalign and such) are not
+   counted either. Each thread counts its own calls, so that those of a
+   thread (e.g. a host starting a game, see host.c) don't show up in the
+   steps taken by another. */
+
+extern void *__libc_malloc (size_t);
+extern void *__libc_calloc (size_t, size_t);
+extern void *__libc_realloc (void *, size_t);
+extern void __libc_free (void *);
+
+extern char __executable_start[], etext[]; /* Bounds of the game's code. */
+
+static __thread size_t calls;
+
+#define COUNT()								\
+  do									\
+    {									\
+      char *caller = __builtin_return_address (0);			\
+      if ((caller >= __executable_start) && (caller < etext))		\
+	calls++;							\
+    }									\
+  while (0)
+
+void *malloc (size_t size)
+{
+  COUNT();
+  return __libc_malloc (size);
+}
+
+void *calloc (size_t count, size_t size)
+{
+  COUNT();
+  return __libc_calloc (count, size);
+}
+
+void *realloc (void *p, size_t size)
+{
+  COUNT();
+  return __libc_realloc (p, size);
+}
+
+void free (void *p)
+{
+  COUNT();
+  __libc_free (p);
+}
+
+size_t alloc_calls (void)
+{
+  return calls;
+}
+
+#endif /* ALLOC_CHECK */
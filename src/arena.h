@@ -0,0 +1,76 @@
+/* arena.h - Memory for the game.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* An arena is a block of memory allocated once, from which objects are
+   carved in turn and released all at once by resetting it. The game
+   takes all its per-game memory from an arena, so that playing (and
+   restarting) doesn't touch the heap. */
+
+typedef struct arena_st
+{
+  char *base;			/* The block. */
+  size_t size;			/* Its size in bytes. */
+  size_t used;			/* Bytes carved so far. */
+  int reserved;			/* Whether made by arena_reserve(). */
+} arena_t;
+
+/* Allocate size bytes for the arena. Return 0 on success, or -1 on
+   failure (errno is set). */
+
+int arena_init (arena_t *arena, size_t size);
+
+/* Reserve size bytes of address space for the arena. Memory is only
+   taken as pages are first written, and given back on reset, so that a
+   large arena costs what is actually used of it. Return 0 on success, or
+   -1 on failure (errno is set). */
+
+int arena_reserve (arena_t *arena, size_t size);
+
+/* Carve size bytes from the arena, aligned for any object. Return NULL
+   if the arena is full. */
+
+void *arena_alloc (arena_t *arena, size_t size);
+
+/* Release all objects carved from the arena. */
+
+void arena_reset (arena_t *arena);
+
+/* Give the arena memory back to the heap. */
+
+void arena_free (arena_t *arena);
+
+#ifdef ALLOC_CHECK
+
+/* Return how many times malloc, calloc, realloc and free were called so
+   far by the game code, in the calling thread. Debug builds (configure
+   --enable-alloc-check) use it to check that the game loop doesn't
+   allocate. */
+
+size_t alloc_calls (void);
+
+#endif
+
+#endif /* ARENA_H */
@@ -0,0 +1,210 @@
+/* controller.c - External snake controllers.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <config.h>
+
+#include "controller.h"
+
+#define STOP_WAITS     100	/* Waits for the controller to exit, */
+#define STOP_WAIT_NSEC 10000000	/* of 10ms each. */
+
+int controlled;
+
+static pid_t controller;	/* The controller process. */
+static int to_controller = -1, from_controller = -1; /* Our pipe ends. */
+
+/* The next observation. Cells are noted as they change, right after room
+   for the longest header and blocks; when the observation is sent, these
+   are put just before the cells, so that the whole of it goes out with a
+   single write, without copying the cells. */
+
+static struct
+{
+  char room[sizeof (obs_header_t) + OBS_MAX_BLOCKS * sizeof (obs_block_t)];
+  obs_cell_t cell[OBS_MAX_CELLS];
+} message;
+
+static int ncells;		/* Cells noted so far. */
+static int resync = 1;		/* Whether the next observation is a resync. */
+
+/* Start the controller, with pipes to its standard input and output. */
+
+int controller_start (const char *command)
+{
+  int down[2], up[2];
+  struct sigaction act;
+
+  if (pipe (down) < 0)
+    return -1;
+  if (pipe (up) < 0)
+    {
+      close (down[0]);
+      close (down[1]);
+      return -1;
+    }
+
+  controller = fork ();
+  if (controller < 0)
+    {
+      close (down[0]);
+      close (down[1]);
+      close (up[0]);
+      close (up[1]);
+      return -1;
+    }
+
+  /* The controller gets a process group of its own, so that it isn't
+     sent the signals the game sends to its own (see quit). */
+
+  if (controller == 0)
+    {
+      setpgid (0, 0);
+      dup2 (down[0], STDIN_FILENO);
+      dup2 (up[1], STDOUT_FILENO);
+      close (down[0]);
+      close (down[1]);
+      close (up[0]);
+      close (up[1]);
+      execl ("/bin/sh", "sh", "-c", command, (char *) NULL);
+      _exit (127);
+    }
+
+  close (down[0]);
+  close (up[1]);
+  to_controller = down[1];
+  from_controller = up[0];
+
+  /* A controller which is gone is noticed by the failed write, rather
+     than killing us with SIGPIPE. */
+
+  sigaction (SIGPIPE, NULL, &act);
+  act.sa_handler = SIG_IGN;
+  sigaction (SIGPIPE, &act, NULL);
+
+  controlled = 1;
+  return 0;
+}
+
+/* Note a changed cell. */
+
+void controller_cell (int y, int x, char c)
+{
+  obs_cell_t *cell;
+
+  if (ncells == OBS_MAX_CELLS)
+    {
+      controller_resync ();
+      return;
+    }
+
+  cell = &message.cell[ncells++];
+  cell->y = y;
+  cell->x = x;
+  cell->c = c;
+  cell->pad = 0;
+}
+
+/* Drop the cells noted; the whole playfield will be listed instead. */
+
+void controller_resync (void)
+{
+  resync = 1;
+  ncells = 0;
+}
+
+int controller_resyncing (void)
+{
+  return resync;
+}
+
+/* Send the observation and take the answer. */
+
+int controller_step (obs_header_t *header, const obs_block_t *blocks)
+{
+  char *start;
+  size_t size;
+  ssize_t done;
+  unsigned char answer;
+
+  if (header->nblocks > OBS_MAX_BLOCKS)
+    header->nblocks = OBS_MAX_BLOCKS;
+  header->ncells = ncells;
+  header->flags = resync ? OBS_RESYNC : 0;
+
+  start = (char *) message.cell - header->nblocks * sizeof (obs_block_t)
+    - sizeof (*header);
+  memcpy (start, header, sizeof (*header));
+  memcpy (start + sizeof (*header), blocks, header->nblocks * sizeof (obs_block_t));
+  size = (char *) &message.cell[ncells] - start;
+
+  /* Observations larger than the pipe are taken in parts. */
+
+  while (size > 0)
+    {
+      done = write (to_controller, start, size);
+      if (done <= 0)
+	return -1;
+      start += done;
+      size -= done;
+    }
+
+  ncells = 0;
+  resync = 0;
+
+  if (read (from_controller, &answer, 1) != 1)
+    return -1;
+  return answer;
+}
+
+/* Let the controller know the game is over, by the end of its input. It
+   is given a while to exit by itself. */
+
+void controller_stop (void)
+{
+  struct timespec how_long;
+  int i;
+
+  if (!controlled)
+    return;
+
+  close (to_controller);
+  close (from_controller);
+
+  how_long.tv_sec = 0;
+  how_long.tv_nsec = STOP_WAIT_NSEC;
+  for (i = 0; waitpid (controller, NULL, WNOHANG) == 0; i++)
+    {
+      if (i == STOP_WAITS)
+	{
+	  kill (controller, SIGTERM);
+	  waitpid (controller, NULL, 0);
+	  break;
+	}
+      nanosleep (&how_long, NULL);
+    }
+  controlled = 0;
+}
@@ -0,0 +1,108 @@
+/* controller.h - External snake controllers.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdint.h>
+
+/* A controller is a program which plays the player's snake. It reads an
+   observation from its standard input at every game step, and answers
+   with a single byte on its standard output: the direction to take.
+
+   An observation is a header, followed by the position of every energy
+   block, followed by the cells of the playfield which changed since the
+   last observation. If the header has OBS_RESYNC set, the controller must
+   forget what it knows of the playfield first: every cell which isn't
+   blank is listed, as after a restart or a rewind. Cells of the borders
+   are never listed; they're deadly, as is any snake.
+
+   All numbers are in the host's byte order. */
+
+#define OBS_RESYNC 1		/* Header flag: the cells are the whole playfield. */
+
+#define CTL_UP    0		/* Answers, as direction_t. */
+#define CTL_RIGHT 1
+#define CTL_LEFT  2
+#define CTL_DOWN  3
+#define CTL_KEEP  0xff		/* Or anything else: go on as before. */
+
+typedef struct obs_header_st
+{
+  uint32_t step;		/* Observations sent before this one. */
+  int32_t  energy;		/* The snake's energy. */
+  uint32_t ncells;		/* Cells which follow the blocks. */
+  uint16_t rows, cols;		/* Size of the playfield, borders included. */
+  uint16_t head_y, head_x;	/* The snake's head. */
+  uint16_t nblocks;		/* Energy blocks which follow. */
+  uint8_t  direction;		/* Where the snake is heading (CTL_*). */
+  uint8_t  flags;		/* OBS_* */
+} obs_header_t;
+
+typedef struct obs_block_st
+{
+  uint16_t y, x;
+} obs_block_t;
+
+typedef struct obs_cell_st
+{
+  uint16_t y, x;
+  char c;			/* As drawn on the board. */
+  char pad;
+} obs_cell_t;
+
+#define OBS_MAX_BLOCKS 64		/* Blocks an observation may list. */
+#define OBS_MAX_CELLS  (1 << 16)	/* Cells an observation may list. */
+
+/* Whether a controller plays the snake. */
+
+extern int controlled;
+
+/* Run command with the shell, as the snake's controller. Return 0 on
+   success or -1 on error. */
+
+int controller_start (const char *command);
+
+/* Note that cell y, x of the playfield now holds c. If too many cells
+   changed for one observation, the next one is a resync. */
+
+void controller_cell (int y, int x, char c);
+
+/* Have the next observation list the whole playfield, e.g. after it
+   changed in ways the controller wasn't told about. */
+
+void controller_resync (void);
+
+/* Whether the next observation is a resync, whose cells are yet to be
+   listed with controller_cell. */
+
+int controller_resyncing (void);
+
+/* Send an observation made of header and blocks, with the cells noted so
+   far, and wait for the answer. Return it, or -1 if the controller is
+   gone. */
+
+int controller_step (obs_header_t *header, const obs_block_t *blocks);
+
+/* Close the controller's pipes and wait for it to exit. */
+
+void controller_stop (void);
+
+#endif /* CONTROLLER_H */
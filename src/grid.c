@@ -0,0 +1,165 @@
+/* grid.c - A screen of cells, drawn apart from ncurses.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "grid.h"
+
+/* Make cell show c, as written now. */
+
+static void put (grid_t *grid, cchar_t *cell, char c)
+{
+  wchar_t text[2];
+
+  text[0] = (unsigned char) c;
+  text[1] = 0;
+  setcchar (cell, text, grid->attrs, grid->pair, NULL);
+}
+
+/* Make n cells from x on, in the row written, blank. */
+
+static void blank (grid_t *grid, int x, int n)
+{
+  cchar_t *row = GRID_ROW (grid, grid->y);
+  int i;
+
+  setcchar (&row[x], L" ", A_NORMAL, 0, NULL);
+  for (i = 1; i < n; i++)
+    row[x + i] = row[x];
+}
+
+/* Return how many of n cells from the cursor are on the grid, and mark
+   its row as written if any is. */
+
+static int reach (grid_t *grid, int n)
+{
+  if ((grid->y < 0) || (grid->y >= grid->rows) || (grid->x < 0))
+    return 0;
+  if (n > grid->cols - grid->x)
+    n = grid->cols - grid->x;
+  if (n > 0)
+    grid->dirty[grid->y] = 1;
+  return n;
+}
+
+int grid_open (grid_t *grid, int max_rows, int max_cols)
+{
+  memset (grid, 0, sizeof (*grid));
+  grid->cells = malloc (sizeof (cchar_t) * max_rows * max_cols);
+  grid->dirty = malloc (max_rows);
+  if (!grid->cells || !grid->dirty)
+    {
+      grid_close (grid);
+      return -1;
+    }
+  grid->max_rows = max_rows;
+  grid->max_cols = max_cols;
+  return 0;
+}
+
+void grid_close (grid_t *grid)
+{
+  free (grid->cells);
+  free (grid->dirty);
+  grid->cells = NULL;
+  grid->dirty = NULL;
+}
+
+void grid_resize (grid_t *grid, int rows, int cols)
+{
+  grid->rows = rows < grid->max_rows ? rows : grid->max_rows;
+  grid->cols = cols < grid->max_cols ? cols : grid->max_cols;
+  grid_move (grid, 0, 0);
+  grid_clrtobot (grid);
+}
+
+void grid_move (grid_t *grid, int y, int x)
+{
+  grid->y = y;
+  grid->x = x;
+}
+
+void grid_attrset (grid_t *grid, attr_t attrs)
+{
+  grid->attrs = attrs & ~A_COLOR;
+  grid->pair = PAIR_NUMBER (attrs);
+}
+
+void grid_addch (grid_t *grid, char c)
+{
+  grid_addnstr (grid, &c, 1);
+}
+
+void grid_addnstr (grid_t *grid, const char *text, int n)
+{
+  cchar_t *row;
+  int i;
+
+  n = reach (grid, n);
+  if (n <= 0)
+    return;
+
+  row = GRID_ROW (grid, grid->y);
+  for (i = 0; i < n; i++)
+    put (grid, &row[grid->x + i], text[i]);
+  grid->x += n;
+}
+
+void grid_add_wchnstr (grid_t *grid, const cchar_t *cells, int n)
+{
+  n = reach (grid, n);
+  if (n > 0)
+    memcpy (&GRID_ROW (grid, grid->y)[grid->x], cells, sizeof (*cells) * n);
+}
+
+void grid_hline (grid_t *grid, char c, int n)
+{
+  cchar_t *row;
+  int i;
+
+  n = reach (grid, n);
+  if (n <= 0)
+    return;
+
+  row = GRID_ROW (grid, grid->y);
+  put (grid, &row[grid->x], c);
+  for (i = 1; i < n; i++)
+    row[grid->x + i] = row[grid->x];
+}
+
+void grid_clrtoeol (grid_t *grid)
+{
+  int n;
+
+  n = reach (grid, grid->cols);
+  if (n > 0)
+    blank (grid, grid->x, n);
+}
+
+void grid_clrtobot (grid_t *grid)
+{
+  int y = grid->y, x = grid->x;
+
+  grid_clrtoeol (grid);
+  for (grid->y++, grid->x = 0; grid->y < grid->rows; grid->y++)
+    grid_clrtoeol (grid);
+  grid_move (grid, y, x);
+}
@@ -0,0 +1,91 @@
+/* grid.h - A screen of cells, drawn apart from ncurses.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GRID_H
+#define GRID_H
+
+#ifndef NCURSES_WIDECHAR
+#define NCURSES_WIDECHAR 1	/* Cells are wide characters. */
+#endif
+#include <ncurses.h>
+
+/* A game draws on a grid of its own, not on an ncurses window: ncurses
+   keeps a single screen per process, which many games of a host can't
+   share. The grid is written with calls named after ncurses' own, and
+   remembers the rows written, so that only those are shown (see
+   show_frame). Cells are kept as ncurses' cchar_t, made with setcchar,
+   which touches no screen. */
+
+typedef struct grid_st
+{
+  cchar_t *cells;		/* Row by row, cols cells each. */
+  char *dirty;			/* Whether each row was written to. */
+  int rows, cols;		/* Size of the grid. */
+  int max_rows, max_cols;	/* Most it may be resized to. */
+  int y, x;			/* Where the next char goes. */
+  attr_t attrs;			/* What it's written with, as setcchar's. */
+  short pair;
+} grid_t;
+
+/* The cells of row y. */
+
+#define GRID_ROW(grid, y) ((grid)->cells + (y) * (grid)->cols)
+
+/* Allocate a grid which may take up to max_rows x max_cols. Return 0 on
+   success, -1 on failure (see errno). */
+
+int grid_open (grid_t *grid, int max_rows, int max_cols);
+
+/* Free the memory of the grid. */
+
+void grid_close (grid_t *grid);
+
+/* Resize the grid to rows x cols, blank. */
+
+void grid_resize (grid_t *grid, int rows, int cols);
+
+/* Move to row y, column x. */
+
+void grid_move (grid_t *grid, int y, int x);
+
+/* Write with attrs, which may hold a COLOR_PAIR, as wattrset. */
+
+void grid_attrset (grid_t *grid, attr_t attrs);
+
+/* Write c, or n chars of text, and move past them. Nothing is written
+   past the right margin. */
+
+void grid_addch (grid_t *grid, char c);
+void grid_addnstr (grid_t *grid, const char *text, int n);
+
+/* Write n cells, made elsewhere, without moving. */
+
+void grid_add_wchnstr (grid_t *grid, const cchar_t *cells, int n);
+
+/* Write n times c without moving, as whline. */
+
+void grid_hline (grid_t *grid, char c, int n);
+
+/* Blank the rest of the row, or the rest of the grid, without moving. */
+
+void grid_clrtoeol (grid_t *grid);
+void grid_clrtobot (grid_t *grid);
+
+#endif /* GRID_H */
@@ -0,0 +1,856 @@
+/* host.c - Many game sessions served by one host.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE		/* For accept4, memfd_create and EPOLLEXCLUSIVE. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <config.h>
+
+#include "utils.h"
+#include "stats.h"
+#include "host.h"
+
+/* Room for the three descriptors of a terminal, as ancillary data. */
+
+typedef union control_un
+{
+  struct cmsghdr header;
+  char space[CMSG_SPACE (3 * sizeof (int))];
+} control_t;
+
+/* What a loop waits for. */
+
+enum {W_LISTENER, W_STOP, W_PEER, W_INPUT, W_OUTPUT, W_TIMER, N_WATCHES};
+
+typedef struct session_st session_t;
+
+typedef struct watch_st
+{
+  session_t *session;		/* Whose it is, if anyone's. */
+  int what;			/* W_*. */
+} watch_t;
+
+/* A player's session. Until the terminal is handed over, only the socket
+   is watched. What the game draws is queued in a file in memory, which
+   never fills up, so that drawing doesn't block: the game writes straight
+   to it, and the loop sends it on to the terminal as the terminal takes
+   it. Whatever was sent is dropped when the whole file is. */
+
+struct session_st
+{
+  host_term_t term;		/* The terminal, as the game sees it. */
+  int peer;			/* Socket to the player's side. */
+  int input, output;		/* The terminal, or -1. */
+  int input_flags, output_flags; /* Their file status flags, to restore. */
+  int queue;			/* Output not sent yet, or -1. */
+  int timer;			/* Goes off when the game is due, or -1. */
+  uint64_t sent;		/* Bytes of the queue sent. */
+  uint64_t dropped;		/* Bytes sent and dropped from the queue. */
+  uint64_t blocked;		/* Usec the terminal kept output waiting, */
+  uint64_t blocked_since;	/* and since when it does, or 0. */
+  int gone;			/* Whether the terminal is gone. */
+  void *game;			/* The game, while it's played. */
+  int ending;			/* Whether the game is over. */
+  int ended;			/* Whether the session is. */
+  watch_t watch[N_WATCHES];
+  session_t *next, *previous;	/* The loop's sessions. */
+};
+
+/* A loop, which plays the sessions it took on. */
+
+typedef struct loop_st
+{
+  pthread_t thread;
+  int epoll;			/* What it waits for. */
+  session_t *sessions;		/* Those not ended. */
+  session_t *ended;		/* Those ended, to free once it's safe. */
+  int stopping;			/* Whether the host is stopping. */
+} loop_t;
+
+static const host_game_t *hosted; /* The game played in each session. */
+static int listener = -1;	/* Socket players join at. */
+static int stop_event = -1;	/* Tells the loops the host is stopping. */
+static watch_t listener_watch = {NULL, W_LISTENER};
+static watch_t stop_watch = {NULL, W_STOP};
+
+static int peer = -1;		/* Socket to the host (joining). */
+
+/* Fill address with path. */
+
+static int address_of (const char *path, struct sockaddr_un *address)
+{
+  if (strlen (path) >= sizeof (address->sun_path))
+    {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+
+  memset (address, 0, sizeof (*address));
+  address->sun_family = AF_UNIX;
+  strcpy (address->sun_path, path);
+  return 0;
+}
+
+/* Have the loop wait for what of session s, on fd. */
+
+static int watch (loop_t *loop, session_t *s, int what, int fd, uint32_t events)
+{
+  struct epoll_event event;
+
+  s->watch[what].session = s;
+  s->watch[what].what = what;
+  event.events = events;
+  event.data.ptr = &s->watch[what];
+  return epoll_ctl (loop->epoll, EPOLL_CTL_ADD, fd, &event);
+}
+
+/* Have the timer of session s go off at the given time (as
+   monotonic_usec). */
+
+static void wake_at (session_t *s, uint64_t usec)
+{
+  struct itimerspec when;
+
+  memset (&when, 0, sizeof (when));
+  when.it_value.tv_sec = usec / 1000000;
+  when.it_value.tv_nsec = usec % 1000000 * 1000 + 1; /* Never 0, which disarms. */
+  timerfd_settime (s->timer, TFD_TIMER_ABSTIME, &when, NULL);
+}
+
+/* Send the terminal what the game drew, as much as it takes. If it takes
+   everything, the queue is emptied. */
+
+static void send_queued (session_t *s)
+{
+  char buffer[HOST_CHUNK];
+  off_t end;
+  ssize_t count, written;
+  uint64_t now;
+
+  if (s->queue < 0)
+    return;
+
+  fflush (s->term.out);
+  end = lseek (s->queue, 0, SEEK_CUR);
+
+  while (!s->gone && ((off_t) s->sent < end))
+    {
+      count = pread (s->queue, buffer,
+		     (end - s->sent < HOST_CHUNK) ? end - s->sent : HOST_CHUNK, s->sent);
+      if (count <= 0)
+	break;
+
+      written = write (s->output, buffer, count);
+      now = monotonic_usec();
+      if (written < 0)
+	{
+	  if ((errno != EAGAIN) && (errno != EINTR))
+	    s->gone = 1;
+	  else if (!s->blocked_since)
+	    s->blocked_since = now;
+	  break;
+	}
+
+      if (s->blocked_since)
+	{
+	  s->blocked += now - s->blocked_since;
+	  STAT_ADD (write_block_usec, now - s->blocked_since);
+	  s->blocked_since = 0;
+	}
+      STAT_ADD (writes_out, 1);
+      STAT_ADD (bytes_out, written);
+      s->sent += written;
+
+      /* The terminal took part of it: it's full. It tells when it isn't
+	 (see W_OUTPUT). */
+
+      if (written < count)
+	{
+	  s->blocked_since = now;
+	  break;
+	}
+    }
+
+  /* A terminal which is gone takes everything. */
+
+  if (s->gone)
+    s->sent = end;
+
+  if (((off_t) s->sent == end) && (end > 0))
+    {
+      if (ftruncate (s->queue, 0) == 0)
+	{
+	  lseek (s->queue, 0, SEEK_SET);
+	  s->dropped += s->sent;
+	  s->sent = 0;
+	}
+    }
+}
+
+/* Return whether all the game drew was sent, or can't be. */
+
+static int sent_all (session_t *s)
+{
+  return s->gone || (lseek (s->queue, 0, SEEK_CUR) == (off_t) s->sent);
+}
+
+/* End session s: the player gets the terminal back as it was, and the
+   socket is closed, so that the player's side is done. It's only freed
+   once the loop is done with the events at hand, which may be about it. */
+
+static void end_session (loop_t *loop, session_t *s)
+{
+  if (s->ended)
+    return;
+
+  if (s->game)
+    hosted->close (s->game);
+
+  /* The terminal stays open in the player's process, so closing it here
+     wouldn't take it off the loop's watch list. */
+
+  if (s->input >= 0)
+    epoll_ctl (loop->epoll, EPOLL_CTL_DEL, s->input, NULL);
+  if (s->output >= 0)
+    epoll_ctl (loop->epoll, EPOLL_CTL_DEL, s->output, NULL);
+
+  if (s->output_flags >= 0)
+    fcntl (s->output, F_SETFL, s->output_flags);
+  if (s->input_flags >= 0)
+    fcntl (s->input, F_SETFL, s->input_flags);
+
+  if (s->input >= 0)
+    close (s->input);
+  if (s->output >= 0)
+    close (s->output);
+  if (s->term.out)
+    fclose (s->term.out);	/* And the queue with it. */
+  else if (s->queue >= 0)
+    close (s->queue);
+  if (s->timer >= 0)
+    close (s->timer);
+  close (s->peer);
+
+  if (s->next)
+    s->next->previous = s->previous;
+  if (s->previous)
+    s->previous->next = s->next;
+  else
+    loop->sessions = s->next;
+
+  s->ended = 1;
+  s->next = loop->ended;
+  loop->ended = s;
+}
+
+/* The game of session s is over. What it drew last is sent, for a while
+   if the terminal is slow, and then the session ends. */
+
+static void game_over (loop_t *loop, session_t *s)
+{
+  hosted->close (s->game);
+  s->game = NULL;
+  s->ending = 1;
+
+  send_queued (s);
+  if (sent_all (s))
+    end_session (loop, s);
+  else
+    wake_at (s, monotonic_usec() + HOST_LINGER);
+}
+
+/* Play the game of session s, which is due. */
+
+static void play (loop_t *loop, session_t *s)
+{
+  uint64_t due;
+
+  due = hosted->play (s->game);
+  send_queued (s);
+
+  if (s->gone)
+    hosted->signal (s->game, SIGHUP);
+
+  if (due)
+    wake_at (s, due);
+  else
+    game_over (loop, s);
+}
+
+/* Take the player's terminal, handed over through the socket of session
+   s, and start its game. Return 0 if it's not here yet, 1 if the game
+   started, or -1 if the session is to end. */
+
+static int take_terminal (loop_t *loop, session_t *s)
+{
+  char c;
+  control_t control;
+  struct msghdr message;
+  struct iovec iov;
+  struct cmsghdr *header;
+  int fds[3];
+  ssize_t n;
+
+  iov.iov_base = &c;
+  iov.iov_len = 1;
+  memset (&message, 0, sizeof (message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = &control;
+  message.msg_controllen = sizeof (control);
+
+  n = recvmsg (s->peer, &message, MSG_CMSG_CLOEXEC);
+  if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+    return 0;
+
+  header = n > 0 ? CMSG_FIRSTHDR (&message) : NULL;
+  if (!header || (message.msg_flags & MSG_CTRUNC)
+      || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+      || header->cmsg_len != CMSG_LEN (sizeof (fds)))
+    return -1;
+  memcpy (fds, CMSG_DATA (header), sizeof (fds));
+
+  s->input = fds[0];
+  s->output = fds[1];
+  close (fds[2]);
+
+  /* Neither reading the terminal nor writing to it may block the loop.
+     The flags are shared with the player's side, so they are restored at
+     the end. */
+
+  s->input_flags = fcntl (s->input, F_GETFL);
+  s->output_flags = fcntl (s->output, F_GETFL);
+  if ((s->input_flags < 0) || (s->output_flags < 0)
+      || (fcntl (s->input, F_SETFL, s->input_flags | O_NONBLOCK) < 0)
+      || (fcntl (s->output, F_SETFL, s->output_flags | O_NONBLOCK) < 0))
+    return -1;
+
+  s->queue = memfd_create (ALT_SHORT_NAME "-output", MFD_CLOEXEC);
+  if (s->queue < 0)
+    return -1;
+  s->term.out = fdopen (s->queue, "w");
+  if (!s->term.out)
+    return -1;
+  s->term.fd = s->output;
+
+  s->timer = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if ((s->timer < 0)
+      || (watch (loop, s, W_INPUT, s->input, EPOLLIN) < 0)
+      || (watch (loop, s, W_OUTPUT, s->output, EPOLLOUT | EPOLLET) < 0)
+      || (watch (loop, s, W_TIMER, s->timer, EPOLLIN) < 0))
+    return -1;
+
+  s->game = hosted->open (&s->term);
+  if (!s->game)
+    return -1;
+
+  wake_at (s, monotonic_usec());
+  return 1;
+}
+
+/* Take a new session, from a player who joined at the socket. */
+
+static void new_session (loop_t *loop, int client)
+{
+  session_t *s;
+
+  s = calloc (1, sizeof (*s));
+  if (!s)
+    {
+      close (client);
+      return;
+    }
+
+  s->peer = client;
+  s->input = s->output = s->queue = s->timer = -1;
+  s->input_flags = s->output_flags = -1;
+
+  s->next = loop->sessions;
+  if (s->next)
+    s->next->previous = s;
+  loop->sessions = s;
+
+  if (watch (loop, s, W_PEER, s->peer, EPOLLIN) < 0)
+    end_session (loop, s);
+}
+
+/* Take what the player's side of session s sent. Before the terminal is
+   handed over, that's the terminal; after, what the terminal signaled. */
+
+static void peer_says (loop_t *loop, session_t *s)
+{
+  ssize_t n;
+  char c;
+
+  if (!s->game && !s->ending)
+    {
+      if (take_terminal (loop, s) < 0)
+	end_session (loop, s);
+      return;
+    }
+
+  while ((n = read (s->peer, &c, 1)) == 1)
+    if (s->game && ((c == HOST_RESIZE) || (c == HOST_QUIT)))
+      hosted->signal (s->game, c == HOST_RESIZE ? SIGWINCH : SIGINT);
+
+  /* The player's side is gone: so is the player. */
+
+  if ((n == 0) || ((n < 0) && (errno != EAGAIN) && (errno != EINTR)))
+    {
+      epoll_ctl (loop->epoll, EPOLL_CTL_DEL, s->peer, NULL);
+      if (s->game)
+	hosted->signal (s->game, SIGHUP);
+    }
+}
+
+/* Take the keys the player of session s pressed. */
+
+static void player_types (loop_t *loop, session_t *s)
+{
+  char keys[64];
+  ssize_t n, i;
+
+  while ((n = read (s->input, keys, sizeof (keys))) > 0)
+    for (i = 0; s->game && (i < n); i++)
+      hosted->key (s->game, (unsigned char) keys[i]);
+
+  /* The terminal is gone. */
+
+  if ((n == 0) || ((n < 0) && (errno != EAGAIN) && (errno != EINTR)))
+    {
+      epoll_ctl (loop->epoll, EPOLL_CTL_DEL, s->input, NULL);
+      if (s->game)
+	hosted->signal (s->game, SIGHUP);
+    }
+}
+
+/* Take the players waiting at the socket. Wherever a player waits, one
+   of the loops which are waiting is woken up (EPOLLEXCLUSIVE), which
+   takes all those waiting. If it's out of descriptors, the others wait
+   until another player joins. */
+
+static void take_players (loop_t *loop)
+{
+  int client;
+
+  while ((client = accept4 (listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    new_session (loop, client);
+}
+
+/* The host is stopping: games are ended, and new players are no longer
+   taken. */
+
+static void stop_loop (loop_t *loop)
+{
+  session_t *s, *next;
+
+  loop->stopping = 1;
+  epoll_ctl (loop->epoll, EPOLL_CTL_DEL, listener, NULL);
+  epoll_ctl (loop->epoll, EPOLL_CTL_DEL, stop_event, NULL);
+
+  for (s = loop->sessions; s; s = next)
+    {
+      next = s->next;
+      if (s->game)
+	hosted->signal (s->game, SIGTERM);
+      else if (!s->ending)
+	end_session (loop, s);
+    }
+}
+
+/* Run a loop until the host is stopping and its sessions are over. */
+
+static void *run_loop (void *arg)
+{
+  loop_t *loop = arg;
+  struct epoll_event events[HOST_EVENTS];
+  session_t *s;
+  watch_t *w;
+  uint64_t expirations;
+  int i, n;
+
+  while (!loop->stopping || loop->sessions)
+    {
+      n = epoll_wait (loop->epoll, events, HOST_EVENTS, -1);
+
+      for (i = 0; i < n; i++)
+	{
+	  w = events[i].data.ptr;
+	  s = w->session;
+	  if (s && s->ended)
+	    continue;
+
+	  switch (w->what)
+	    {
+	    case W_LISTENER:
+	      if (!loop->stopping)
+		take_players (loop);
+	      break;
+	    case W_STOP:
+	      stop_loop (loop);
+	      break;
+	    case W_PEER:
+	      peer_says (loop, s);
+	      break;
+	    case W_INPUT:
+	      player_types (loop, s);
+	      break;
+	    case W_OUTPUT:
+	      send_queued (s);
+	      if (s->ending && sent_all (s))
+		end_session (loop, s);
+	      break;
+	    case W_TIMER:
+	      if (read (s->timer, &expirations, sizeof (expirations)) < 0)
+		break;
+	      if (s->ending)
+		end_session (loop, s); /* Given up on the terminal. */
+	      else
+		play (loop, s);
+	      break;
+	    }
+	}
+
+      while ((s = loop->ended))
+	{
+	  loop->ended = s->next;
+	  free (s);
+	}
+    }
+
+  return NULL;
+}
+
+/* Serve sessions. */
+
+int host_serve (const char *path, const host_game_t *game)
+{
+  struct sockaddr_un address;
+  struct sigaction act;
+  struct stat status;
+  struct epoll_event event;
+  struct rlimit limit;
+  sigset_t signals, old_mask;
+  loop_t *loops;
+  long nloops, i, started;
+  uint64_t one = 1;
+  int signum;
+
+  if (address_of (path, &address) < 0)
+    return -1;
+
+  listener = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listener < 0)
+    return -1;
+
+  /* A socket left behind by a host which is gone is replaced; one which
+     still answers is not. */
+
+  if (lstat (path, &status) == 0 && S_ISSOCK (status.st_mode)
+      && connect (listener, (struct sockaddr *) &address, sizeof (address)) < 0)
+    unlink (path);
+
+  /* Anyone who may reach the socket may play: access is up to the
+     permissions of the directory it's in. */
+
+  if (bind (listener, (struct sockaddr *) &address, sizeof (address)) < 0
+      || chmod (path, 0666) < 0
+      || listen (listener, HOST_BACKLOG) < 0)
+    {
+      close (listener);
+      return -1;
+    }
+
+  /* Every player takes a handful of descriptors. */
+
+  if (getrlimit (RLIMIT_NOFILE, &limit) == 0)
+    {
+      limit.rlim_cur = limit.rlim_max;
+      setrlimit (RLIMIT_NOFILE, &limit);
+    }
+
+  /* SIGINT and SIGTERM are blocked in every thread, and taken by this
+     one, below. The games get what their terminals signal through their
+     sockets: the host's own terminal signals nothing to them, and the
+     handlers ncurses may have set for the games' screen are overridden. */
+
+  sigemptyset (&signals);
+  sigaddset (&signals, SIGINT);
+  sigaddset (&signals, SIGTERM);
+  pthread_sigmask (SIG_BLOCK, &signals, &old_mask);
+
+  memset (&act, 0, sizeof (act));
+  sigemptyset (&act.sa_mask);
+  act.sa_handler = SIG_IGN;
+  sigaction (SIGWINCH, &act, NULL);
+  sigaction (SIGTSTP, &act, NULL);
+  sigaction (SIGPIPE, &act, NULL);
+
+  stop_event = eventfd (0, EFD_CLOEXEC);
+  if (stop_event < 0)
+    goto fail;
+
+  /* The loops, one per processor. */
+
+  hosted = game;
+  nloops = sysconf (_SC_NPROCESSORS_ONLN);
+  if (nloops < 1)
+    nloops = 1;
+  loops = calloc (nloops, sizeof (*loops));
+  if (!loops)
+    goto fail;
+  for (i = 0; i < nloops; i++)
+    loops[i].epoll = -1;
+
+  for (started = 0; started < nloops; started++)
+    {
+      loops[started].epoll = epoll_create1 (EPOLL_CLOEXEC);
+      if (loops[started].epoll < 0)
+	break;
+
+      event.events = EPOLLIN | EPOLLET | EPOLLEXCLUSIVE;
+      event.data.ptr = &listener_watch;
+      if (epoll_ctl (loops[started].epoll, EPOLL_CTL_ADD, listener, &event) < 0)
+	break;
+      event.events = EPOLLIN;
+      event.data.ptr = &stop_watch;
+      if (epoll_ctl (loops[started].epoll, EPOLL_CTL_ADD, stop_event, &event) < 0)
+	break;
+
+      if (pthread_create (&loops[started].thread, NULL, run_loop, &loops[started]))
+	break;
+    }
+
+  /* Serve until told to stop, with as many loops as could be started. */
+
+  if (started > 0)
+    while (sigwait (&signals, &signum))
+      ;
+
+  if (write (stop_event, &one, sizeof (one)) < 0)
+    perror ("host");
+
+  for (i = 0; i < started; i++)
+    pthread_join (loops[i].thread, NULL);
+  for (i = 0; i < nloops; i++)
+    if (loops[i].epoll >= 0)
+      close (loops[i].epoll);
+  free (loops);
+
+  close (stop_event);
+  close (listener);
+  unlink (path);
+  pthread_sigmask (SIG_SETMASK, &old_mask, NULL);
+  return started > 0 ? 0 : -1;
+
+ fail:
+  if (stop_event >= 0)
+    close (stop_event);
+  close (listener);
+  unlink (path);
+  pthread_sigmask (SIG_SETMASK, &old_mask, NULL);
+  return -1;
+}
+
+/* Return the bytes the game wrote to term. */
+
+size_t host_total (host_term_t *term)
+{
+  session_t *s = (session_t *) term;
+  off_t end;
+
+  fflush (term->out);		/* What stdio holds isn't in the queue yet. */
+  end = lseek (s->queue, 0, SEEK_CUR);
+  return s->dropped + (end > 0 ? end : 0);
+}
+
+/* Return the bytes the game wrote to term which weren't sent yet. */
+
+size_t host_pending (host_term_t *term)
+{
+  session_t *s = (session_t *) term;
+  size_t pending;
+  int buffered = 0;
+
+  pending = host_total (term) - s->dropped - s->sent;
+  if ((ioctl (s->output, TIOCOUTQ, &buffered) == 0) && (buffered > 0))
+    pending += buffered;
+
+  return pending;
+}
+
+/* Return how long term kept output waiting. */
+
+uint64_t host_blocked (host_term_t *term)
+{
+  session_t *s = (session_t *) term;
+
+  return s->blocked + (s->blocked_since ? monotonic_usec() - s->blocked_since : 0);
+}
+
+/* Tell the session what the terminal signaled. */
+
+static void forward (int signum)
+{
+  int saved = errno;
+  char c = signum == SIGWINCH ? HOST_RESIZE : HOST_QUIT;
+  ssize_t n;
+
+  n = write (peer, &c, 1);	/* If the session is gone, read() tells. */
+  (void) n;
+
+  errno = saved;
+}
+
+/* Join a host. */
+
+int host_join (const char *path)
+{
+  struct sockaddr_un address;
+  char c;
+  control_t control;
+  struct msghdr message;
+  struct iovec iov;
+  struct cmsghdr *header;
+  struct sigaction act;
+  struct termios modes, saved_modes;
+  int fds[3], flags[3], i, modes_set;
+  ssize_t n;
+
+  if (address_of (path, &address) < 0)
+    return -1;
+
+  peer = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (peer < 0)
+    return -1;
+  if (connect (peer, (struct sockaddr *) &address, sizeof (address)) < 0)
+    {
+      close (peer);
+      return -1;
+    }
+
+  /* Hand over the terminal, along with a byte of data, which the
+     ancillary data needs to go with. */
+
+  c = '\0';
+  fds[0] = STDIN_FILENO;
+  fds[1] = STDOUT_FILENO;
+  fds[2] = STDERR_FILENO;
+
+  iov.iov_base = &c;
+  iov.iov_len = 1;
+  memset (&message, 0, sizeof (message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = &control;
+  message.msg_controllen = CMSG_SPACE (sizeof (fds));
+
+  header = CMSG_FIRSTHDR (&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN (sizeof (fds));
+  memcpy (CMSG_DATA (header), fds, sizeof (fds));
+
+  /* The game can't set the terminal's modes from the host, nor can the
+     host be trusted to give them back: set them here, as cbreak() and
+     noecho() would, and keep them and the file status flags (which the
+     host changes) to restore. */
+
+  modes_set = tcgetattr (STDIN_FILENO, &saved_modes) == 0;
+  if (modes_set)
+    {
+      modes = saved_modes;
+      modes.c_lflag &= ~(ICANON | ECHO);
+      modes.c_iflag &= ~ICRNL;
+      modes.c_cc[VMIN] = 1;
+      modes.c_cc[VTIME] = 0;
+      tcsetattr (STDIN_FILENO, TCSADRAIN, &modes);
+    }
+  for (i = 0; i < 3; i++)
+    flags[i] = fcntl (fds[i], F_GETFL);
+
+  if (sendmsg (peer, &message, 0) < 0)
+    {
+      if (modes_set)
+	tcsetattr (STDIN_FILENO, TCSADRAIN, &saved_modes);
+      close (peer);
+      return -1;
+    }
+
+  /* Relay what the terminal signals until the session is over, when the
+     socket is closed. The game can't be suspended from here. */
+
+  memset (&act, 0, sizeof (act));
+  sigemptyset (&act.sa_mask);
+  act.sa_handler = forward;
+  sigaction (SIGWINCH, &act, NULL);
+  sigaction (SIGINT, &act, NULL);
+  sigaction (SIGQUIT, &act, NULL);
+  sigaction (SIGTERM, &act, NULL);
+  sigaction (SIGHUP, &act, NULL);
+  act.sa_handler = SIG_IGN;
+  sigaction (SIGTSTP, &act, NULL);
+
+  while ((n = read (peer, &c, 1)) != 0)
+    if (n < 0 && errno != EINTR)
+      break;
+
+  close (peer);
+
+  for (i = 0; i < 3; i++)
+    if (flags[i] >= 0)
+      fcntl (fds[i], F_SETFL, flags[i]);
+  if (modes_set)
+    tcsetattr (STDIN_FILENO, TCSADRAIN, &saved_modes);
+  return 0;
+}
+
+/* Protect what the host read. */
+
+void host_share (const void *data, size_t size)
+{
+  uintptr_t page, start, end;
+
+  page = sysconf (_SC_PAGESIZE);
+  start = ((uintptr_t) data + page - 1) / page * page;
+  end = ((uintptr_t) data + size) / page * page;
+
+  if (end > start)
+    mprotect ((void *) start, end - start, PROT_READ);
+}
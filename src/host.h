@@ -0,0 +1,124 @@
+/* host.h - Many game sessions served by one host.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A host reads the scenes once, and listens on a Unix socket. A player
+   joins by handing over its terminal through the socket: its standard
+   input, output and error, passed as file descriptors. The player's side
+   puts the terminal in the modes the game needs (those of cbreak() and
+   noecho()) and back when the session is over. Terminals are driven with
+   ANSI sequences (see ansi.h), whatever their type.
+
+   Each game is a state object, played by one of a small pool of threads,
+   one per processor, each of which runs an event loop for the games it
+   took on: it plays them when they're due, hands them the keys their
+   players press, and sends what they draw to their terminals without
+   ever blocking on one. All of them share the scenes read by the host, so
+   that memory and threads grow with the players who are playing, not with
+   processes.
+
+   While a session plays, the player's side of the socket only carries
+   single bytes, for what the terminal would have signaled to the game:
+   HOST_RESIZE for SIGWINCH and HOST_QUIT for SIGINT (and hangups). The
+   session is over when either side closes the socket. */
+
+#define HOST_RESIZE 'w'
+#define HOST_QUIT   'q'
+
+#define HOST_BACKLOG 64		/* Players who may wait to be accepted. */
+#define HOST_EVENTS  64		/* Events a loop takes at once. */
+#define HOST_CHUNK   (1 << 14)	/* Most bytes sent to a terminal at once. */
+#define HOST_LINGER  1000000	/* Usec given to send what's left at the end. */
+
+/* A player's terminal, as a hosted game sees it. */
+
+typedef struct host_term_st
+{
+  int fd;			/* The terminal itself (e.g. for its size). */
+  FILE *out;			/* What to write to it. Output is queued: it's
+				   sent by the loop. */
+} host_term_t;
+
+/* The game a host plays for each player. All of its functions are called
+   by the thread which plays the game, and only by that thread. */
+
+typedef struct host_game_st
+{
+  /* Start a game on term, which stays valid until it's closed. Return
+     the game, or NULL if it can't be played. */
+
+  void *(*open) (host_term_t *term);
+
+  /* Play what's due. Return the time (as monotonic_usec) when the game is
+     due again, or 0 if it's over. */
+
+  uint64_t (*play) (void *game);
+
+  /* Take a key pressed by the player. */
+
+  void (*key) (void *game, int c);
+
+  /* Take a signal of the terminal's: SIGWINCH, SIGINT or SIGHUP. A host
+     which is stopping sends SIGTERM. */
+
+  void (*signal) (void *game, int signum);
+
+  /* End the game, once it's over. What it draws by then is still sent. */
+
+  void (*close) (void *game);
+} host_game_t;
+
+/* Serve game on the socket at path, until SIGINT or SIGTERM. Then end the
+   games playing, and return 0 once they're over; return -1 if the host
+   can't serve. */
+
+int host_serve (const char *path, const host_game_t *game);
+
+/* Return how many bytes a hosted game wrote to term so far, whether sent
+   or not. */
+
+size_t host_total (host_term_t *term);
+
+/* Return how many bytes a hosted game wrote to term which haven't been
+   sent yet, either still queued or in the terminal's own buffer. */
+
+size_t host_pending (host_term_t *term);
+
+/* Return how long (usec) term kept output waiting so far. */
+
+uint64_t host_blocked (host_term_t *term);
+
+/* Join the host at path, and wait until the session is over. Return 0 on
+   success, or -1 on error. */
+
+int host_join (const char *path);
+
+/* Make the whole pages of size bytes at data read-only: they hold what
+   the host read for the games, which is never to be written. */
+
+void host_share (const void *data, size_t size);
+
+#endif /* HOST_H */
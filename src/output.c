@@ -0,0 +1,238 @@
+/* output.c - Terminal output queue.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE		/* For F_SETPIPE_SZ. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <config.h>
+
+#include "utils.h"
+#include "stats.h"
+#include "output.h"
+
+/* Ncurses writes to a pipe, and the writer thread hands what comes out of
+   it to the terminal. Counts grow forever: taken is what the writer read
+   from the pipe, sent what it wrote to the terminal. Taken only changes
+   under the lock, together with what is in the pipe, so that their sum,
+   all that ncurses wrote, never seems to go back. */
+
+static int pipe_fds[2] = {-1, -1}; /* Read and write ends of the pipe. */
+static FILE *stream;		/* Ncurses' end of the pipe. */
+static uint64_t taken, sent;	/* Bytes read from the pipe, and written. */
+static pthread_t thread;	/* The writer. */
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct termios saved_modes; /* The terminal's modes, to restore. */
+static int modes_set;		/* Whether the modes were changed. */
+
+/* Return the bytes in the pipe. Called with the lock held. */
+
+static size_t unread (void)
+{
+  int count = 0;
+
+  if ((ioctl (pipe_fds[0], FIONREAD, &count) < 0) || (count < 0))
+    return 0;
+  return count;
+}
+
+/* Hand what ncurses wrote to the terminal. This thread is the one which
+   blocks when the terminal link is slow, and the only writer of bytes_out,
+   writes_out and write_block_usec. It's over once the pipe is closed (at
+   exit) or the terminal is gone; then, the pipe is closed on ncurses,
+   whose writes fail from then on. */
+
+static void *writer (void *arg)
+{
+  static char buffer[OUTPUT_CHUNK];
+  struct pollfd fds;
+  ssize_t count, done, written;
+  uint64_t start;
+  sigset_t all;
+
+  (void) arg;
+
+  /* Leave signals to the game threads. */
+
+  sigfillset (&all);
+  pthread_sigmask (SIG_BLOCK, &all, NULL);
+
+  fds.fd = pipe_fds[0];
+  fds.events = POLLIN;
+
+  while (1)
+    {
+      if ((poll (&fds, 1, -1) < 0) && (errno != EINTR))
+	break;
+
+      pthread_mutex_lock (&lock);
+      count = read (pipe_fds[0], buffer, sizeof (buffer));
+      if (count > 0)
+	taken += count;
+      pthread_mutex_unlock (&lock);
+
+      if (count == 0)
+	break;			/* Ncurses' end is closed. */
+      if (count < 0)
+	{
+	  if ((errno == EINTR) || (errno == EAGAIN))
+	    continue;
+	  break;
+	}
+
+      for (done = 0; done < count; done += written)
+	{
+	  start = monotonic_usec();
+	  written = write (STDOUT_FILENO, buffer + done, count - done);
+	  STAT_ADD (write_block_usec, monotonic_usec() - start);
+	  STAT_ADD (writes_out, 1);
+
+	  if (written < 0)
+	    {
+	      if (errno != EINTR)
+		goto gone;	/* The terminal is gone. */
+	      written = 0;
+	    }
+	  STAT_ADD (bytes_out, written);
+	  __atomic_store_n (&sent, sent + written, __ATOMIC_RELAXED);
+	}
+    }
+
+ gone:
+  close (pipe_fds[0]);
+  return NULL;
+}
+
+/* Send what's left, and give the terminal its modes back. */
+
+static void output_stop (void)
+{
+  fclose (stream);		/* The writer gets to the end of the pipe. */
+  pthread_join (thread, NULL);
+
+  if (modes_set)
+    tcsetattr (STDIN_FILENO, TCSADRAIN, &saved_modes);
+}
+
+/* Start the writer thread. */
+
+int output_start (void)
+{
+  struct sigaction act;
+  struct termios modes;
+
+  if (pipe (pipe_fds) < 0)
+    return -1;
+
+  fcntl (pipe_fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl (pipe_fds[1], F_SETFD, FD_CLOEXEC);
+  fcntl (pipe_fds[1], F_SETPIPE_SZ, OUTPUT_QUEUE_SIZE); /* Best effort. */
+
+  stream = fdopen (pipe_fds[1], "w");
+  if (!stream)
+    {
+      close (pipe_fds[0]);
+      close (pipe_fds[1]);
+      return -1;
+    }
+
+  if (pthread_create (&thread, NULL, writer, NULL))
+    {
+      fclose (stream);
+      close (pipe_fds[0]);
+      return -1;
+    }
+
+  /* Writes to the pipe once the writer is gone fail, rather than killing
+     us with SIGPIPE. */
+
+  sigaction (SIGPIPE, NULL, &act);
+  act.sa_handler = SIG_IGN;
+  sigaction (SIGPIPE, &act, NULL);
+
+  /* Ncurses sets the terminal's modes through its output, which is now
+     the pipe: set them here, as cbreak() and noecho() would. */
+
+  if (tcgetattr (STDIN_FILENO, &saved_modes) == 0)
+    {
+      modes = saved_modes;
+      modes.c_lflag &= ~(ICANON | ECHO);
+      modes.c_iflag &= ~ICRNL;
+      modes.c_cc[VMIN] = 1;
+      modes.c_cc[VTIME] = 0;
+      modes_set = tcsetattr (STDIN_FILENO, TCSADRAIN, &modes) == 0;
+    }
+
+  atexit (output_stop);
+  return 0;
+}
+
+/* Return the stream for ncurses to write to. */
+
+FILE *output_stream (void)
+{
+  return stream ? stream : stdout;
+}
+
+/* Return how many bytes are yet to be sent. */
+
+size_t output_pending (void)
+{
+  size_t pending;
+  int buffered = 0;
+
+  if (!stream)
+    return 0;
+
+  pthread_mutex_lock (&lock);
+  pending = unread () + taken - __atomic_load_n (&sent, __ATOMIC_RELAXED);
+  pthread_mutex_unlock (&lock);
+
+  if ((ioctl (STDOUT_FILENO, TIOCOUTQ, &buffered) == 0) && (buffered > 0))
+    pending += buffered;
+
+  return pending;
+}
+
+/* Return how many bytes were written to the terminal so far. */
+
+size_t output_total (void)
+{
+  size_t total;
+
+  if (!stream)
+    return 0;
+
+  pthread_mutex_lock (&lock);
+  total = unread () + taken;
+  pthread_mutex_unlock (&lock);
+
+  return total;
+}
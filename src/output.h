@@ -0,0 +1,55 @@
+/* output.h - Terminal output queue.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define OUTPUT_QUEUE_SIZE (1 << 16) /* Bytes the terminal may lag behind. */
+#define OUTPUT_CHUNK      (1 << 14) /* Most bytes the writer sends at once. */
+
+/* Start queueing terminal output. Ncurses is to write to output_stream(),
+   a pipe, which a writer thread drains to the standard output, so that a
+   slow terminal link doesn't block ncurses unless the pipe is full. Since
+   ncurses can't reach the terminal through the pipe, the terminal is put
+   in the modes of cbreak() and noecho() here. The pipe is drained and the
+   modes restored at exit. Return 0 on success, or -1 if ncurses is to
+   write to the terminal directly. */
+
+int output_start (void);
+
+/* Return the stream for ncurses to write to (see newterm): the pipe, or
+   the standard output if the queue couldn't be started. */
+
+FILE *output_stream (void);
+
+/* Return how many bytes were written to the terminal but haven't been
+   sent yet, either still queued or in the terminal's own buffer. */
+
+size_t output_pending (void);
+
+/* Return how many bytes were written to the terminal so far, whether
+   already sent or not. */
+
+size_t output_total (void);
+
+#endif /* OUTPUT_H */
@@ -0,0 +1,447 @@
+/* record.c - Session recording.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define NCURSES_WIDECHAR 1	/* Cells are read as wide characters. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <ncurses.h>
+#include <config.h>
+
+#include "utils.h"
+#include "stats.h"
+#include "trace.h"
+#include "record.h"
+#include "ansi.h"
+
+/* An event of the asciicast, as queued: this header, then its data. */
+
+typedef struct event_st
+{
+  uint64_t usec;		/* When it happened (monotonic). */
+  uint32_t length;		/* Bytes of data which follow. */
+  uint32_t type;		/* 'o' for output, 'r' for a resize. */
+} event_t;
+
+int recording;
+
+/* Circular queue of events on their way to the file. There is a single
+   producer (the game loop) and a single consumer (the writer), so each
+   side only ever moves its own count, and publishes it with a release
+   store which the other side reads with an acquire load: no locks, and
+   the game never waits. Counts grow forever, as in output.c. */
+
+static char ring[RECORD_RING_SIZE];
+static uint64_t ring_head, ring_tail;	/* Write and read counts. */
+
+static FILE *file;		/* The asciicast. */
+static char file_buffer[1 << 16]; /* Its stdio buffer. */
+static time_t started;		/* When recording started (wall clock). */
+static pthread_t thread;	/* The writer. */
+static int stopping;		/* Whether the writer should finish. */
+static unsigned long dropped;	/* Frames not recorded. */
+
+/* The screen, as of the last frame recorded, and as of now; they trade
+   places when a frame is recorded. Cells are compared as a whole,
+   attributes and colors included. Each has room for the terminator which
+   ncurses puts after the last row read. */
+
+static cchar_t *shown, *current;
+static int screen_rows, screen_cols;
+
+static int resize_pending;	/* Whether the size is yet to be queued. */
+static int fresh;		/* Whether the next frame starts from blank. */
+
+/* Where the terminal's cursor is, and the attributes it writes with, as
+   of the last frame recorded; a column of -1 means unknown. */
+
+static int cursor_y, cursor_x = -1;
+static attr_t pen_attrs;
+static short pen_pair;
+
+static char frame[RECORD_FRAME_MAX]; /* The frame being encoded. */
+static size_t length;		/* Bytes of it so far. */
+
+/* Copy n bytes to and from the ring at count at, wrapping around. */
+
+static void ring_put (uint64_t at, const void *data, size_t n)
+{
+  size_t offset = at % RECORD_RING_SIZE, part = RECORD_RING_SIZE - offset;
+
+  if (part > n)
+    part = n;
+  memcpy (ring + offset, data, part);
+  memcpy (ring, (const char *) data + part, n - part);
+}
+
+static void ring_get (uint64_t at, void *data, size_t n)
+{
+  size_t offset = at % RECORD_RING_SIZE, part = RECORD_RING_SIZE - offset;
+
+  if (part > n)
+    part = n;
+  memcpy (data, ring + offset, part);
+  memcpy ((char *) data + part, ring, n - part);
+}
+
+/* Queue an event. Return 0, or -1 if there is no room for it. */
+
+static int enqueue (int type, uint64_t usec, const char *data, size_t n)
+{
+  event_t event;
+  uint64_t head, tail;
+
+  head = ring_head;
+  tail = __atomic_load_n (&ring_tail, __ATOMIC_ACQUIRE);
+  if (RECORD_RING_SIZE - (head - tail) < sizeof (event) + n)
+    return -1;
+
+  event.usec = usec;
+  event.length = n;
+  event.type = type;
+  ring_put (head, &event, sizeof (event));
+  ring_put (head + sizeof (event), data, n);
+
+  __atomic_store_n (&ring_head, head + sizeof (event) + n, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/* Write n bytes as the contents of a JSON string. */
+
+static void escape (const char *data, size_t n)
+{
+  unsigned char c;
+
+  for (; n > 0; n--)
+    {
+      c = *data++;
+      if (c == '"' || c == '\\')
+	{
+	  putc ('\\', file);
+	  putc (c, file);
+	}
+      else if (c == '\n')
+	fputs ("\\n", file);
+      else if (c == '\r')
+	fputs ("\\r", file);
+      else if (c < 0x20 || c == 0x7f)
+	fprintf (file, "\\u%04x", c);
+      else
+	putc (c, file);		/* UTF-8 goes as it is. */
+    }
+}
+
+/* Write an event as a line of the asciicast. The first one is a resize,
+   which becomes the header; times are counted from it. */
+
+static void write_event (const event_t *event, const char *data)
+{
+  static uint64_t origin;
+  static int headed;
+  const char *term;
+  int rows, cols;
+
+  if (!headed)
+    {
+      if (event->type != 'r' || sscanf (data, "%dx%d", &cols, &rows) != 2)
+	return;
+      fprintf (file, "{\"version\": 2, \"width\": %d, \"height\": %d, "
+	       "\"timestamp\": %ld, \"title\": \"" PACKAGE_STRING "\"",
+	       cols, rows, (long) started);
+      term = getenv ("TERM");
+      if (term)
+	{
+	  fputs (", \"env\": {\"TERM\": \"", file);
+	  escape (term, strlen (term));
+	  fputs ("\"}", file);
+	}
+      fputs ("}\n", file);
+      origin = event->usec;
+      headed = 1;
+      return;
+    }
+
+  fprintf (file, "[%.6f, \"%c\", \"", (event->usec - origin) / 1E6,
+	   (int) event->type);
+  escape (data, event->length);
+  fputs ("\"]\n", file);
+}
+
+/* Write the queued events. This thread is the one which blocks when the
+   file is slow, and its room in the ring is only given back once events
+   are in the stdio buffer, which is flushed once per batch. */
+
+static void *writer (void *arg)
+{
+  static char data[RECORD_FRAME_MAX + 1];
+  struct timespec how_long;
+  event_t event;
+  uint64_t head, tail;
+  sigset_t all;
+
+  (void) arg;
+
+  /* Leave signals to the game threads. */
+
+  sigfillset (&all);
+  pthread_sigmask (SIG_BLOCK, &all, NULL);
+
+  how_long.tv_sec = 0;
+  how_long.tv_nsec = RECORD_POLL_NSEC;
+
+  tail = ring_tail;
+  while (1)
+    {
+      head = __atomic_load_n (&ring_head, __ATOMIC_ACQUIRE);
+      if (head == tail)
+	{
+	  /* Events queued before stopping was set are seen by now. */
+
+	  if (__atomic_load_n (&stopping, __ATOMIC_ACQUIRE)
+	      && __atomic_load_n (&ring_head, __ATOMIC_ACQUIRE) == tail)
+	    break;
+	  nanosleep (&how_long, NULL);
+	  continue;
+	}
+
+      while (tail != head)
+	{
+	  ring_get (tail, &event, sizeof (event));
+	  ring_get (tail + sizeof (event), data, event.length);
+	  data[event.length] = '\0';
+	  write_event (&event, data);
+	  tail += sizeof (event) + event.length;
+	}
+
+      __atomic_store_n (&ring_tail, tail, __ATOMIC_RELEASE);
+      fflush (file);
+    }
+
+  return NULL;
+}
+
+/* Write what's left and close the asciicast. */
+
+static void record_close (void)
+{
+  if (!recording)
+    return;
+  recording = 0;
+
+  __atomic_store_n (&stopping, 1, __ATOMIC_RELEASE);
+  pthread_join (thread, NULL);
+
+  if (ferror (file) | fclose (file))
+    perror ("recording");
+  if (dropped)
+    fprintf (stderr, "%lu frames were not recorded: "
+	     "the file didn't keep up with the game.\n", dropped);
+
+  free (shown);
+  free (current);
+}
+
+/* Start recording. */
+
+int record_open (const char *path)
+{
+  file = fopen (path, "w");
+  if (!file)
+    return -1;
+  setvbuf (file, file_buffer, _IOFBF, sizeof (file_buffer));
+  started = time (NULL);
+
+  if (pthread_create (&thread, NULL, writer, NULL))
+    {
+      fclose (file);
+      return -1;
+    }
+
+  recording = 1;
+  atexit (record_close);
+  return 0;
+}
+
+/* Start the next frame from a blank screen. */
+
+static void forget_screen (void)
+{
+  int i;
+
+  for (i = 0; i < screen_rows * screen_cols; i++)
+    setcchar (&shown[i], L" ", A_NORMAL, 0, NULL);
+  fresh = 1;
+}
+
+/* Take the new size. */
+
+void record_resize (int rows, int cols)
+{
+  if (!recording || (rows == screen_rows && cols == screen_cols))
+    return;
+
+  free (shown);
+  free (current);
+  shown = malloc (sizeof (*shown) * (rows * cols + 1));
+  current = malloc (sizeof (*current) * (rows * cols + 1));
+  if (!shown || !current)
+    {
+      free (shown);
+      free (current);
+      shown = current = NULL;
+      screen_rows = screen_cols = 0;
+      return;			/* Nothing more is recorded. */
+    }
+
+  screen_rows = rows;
+  screen_cols = cols;
+  forget_screen ();
+  resize_pending = 1;
+}
+
+/* Append text to the frame. */
+
+static void put (const char *text, int n)
+{
+  memcpy (frame + length, text, n);
+  length += n;
+}
+
+/* Count a frame which couldn't be queued. If part of it was, the terminal
+   of the recording is left somewhere in between: the next frame redraws
+   it all. */
+
+static void drop (int parts)
+{
+  dropped++;
+  STAT_ADD (frames_unrecorded, 1);
+  if (parts)
+    forget_screen ();
+}
+
+/* Record a frame.
+
+   The screen is compared cell by cell with the last frame recorded, and
+   only the cells which differ are encoded, each with a cursor move and a
+   change of attributes only where needed. A frame larger than the frame
+   buffer is queued in parts. If there's no room in the ring, the frame is
+   dropped and nothing changes: the next one is compared with the same
+   last frame recorded, so nothing is lost from the screen, only time. */
+
+void record_frame (void)
+{
+  static const char clean[] = ANSI_CLEAR;
+  cchar_t *row, *was, *swap;
+  attr_t now_attrs;
+  short now_pair;
+  int y, x, now_y, now_x, parts = 0;
+  char move[32];
+  uint64_t start;
+
+  if (!recording || !shown)
+    return;
+
+  getmaxyx (curscr, y, x);
+  if (y != screen_rows || x != screen_cols)
+    return;			/* Not told of the new size yet. */
+
+  start = monotonic_usec();
+
+  if (resize_pending)
+    {
+      sprintf (move, "%dx%d", screen_cols, screen_rows);
+      if (enqueue ('r', start, move, strlen (move)) < 0)
+	{
+	  drop (0);
+	  return;
+	}
+      resize_pending = 0;
+    }
+
+  length = 0;
+  now_y = cursor_y;
+  now_x = cursor_x;
+  now_attrs = pen_attrs;
+  now_pair = pen_pair;
+
+  if (fresh)
+    {
+      put (clean, sizeof (clean) - 1);
+      now_y = now_x = 0;
+      now_attrs = A_NORMAL;
+      now_pair = 0;
+    }
+
+  for (y = 0; y < screen_rows; y++)
+    {
+      row = current + y * screen_cols;
+      was = shown + y * screen_cols;
+      mvwin_wchnstr (curscr, y, 0, row, screen_cols);
+      if (!memcmp (row, was, sizeof (*row) * screen_cols))
+	continue;
+
+      for (x = 0; x < screen_cols; x++)
+	{
+	  if (!memcmp (&row[x], &was[x], sizeof (*row)))
+	    continue;
+
+	  if (length > RECORD_FRAME_MAX - ANSI_CELL_MAX)
+	    {
+	      if (enqueue ('o', start, frame, length) < 0)
+		{
+		  drop (parts);
+		  return;
+		}
+	      parts++;
+	      length = 0;
+	    }
+
+	  if (y != now_y || x != now_x)
+	    length += ansi_move (frame + length, y, x);
+	  length += ansi_cell (frame + length, &row[x], &now_attrs, &now_pair);
+
+	  now_y = y;
+	  now_x = x + 1 < screen_cols ? x + 1 : -1; /* Past the margin. */
+	}
+    }
+
+  if (length > 0 && enqueue ('o', start, frame, length) < 0)
+    {
+      drop (parts);
+      return;
+    }
+
+  /* The frame is on its way: it's the last one recorded. */
+
+  swap = shown;
+  shown = current;
+  current = swap;
+  cursor_y = now_y;
+  cursor_x = now_x;
+  pen_attrs = now_attrs;
+  pen_pair = now_pair;
+  fresh = 0;
+
+  trace_span ("record", start);
+}
@@ -0,0 +1,52 @@
+/* record.h - Session recording.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RECORD_H
+#define RECORD_H
+
+/* A session may be recorded as an asciicast (asciinema's format, version
+   2), which any asciinema player replays. The game hands frames over to a
+   thread of its own, which writes them; if the file takes them slower than
+   they come, frames are dropped rather than waited for. */
+
+#define RECORD_RING_SIZE (1 << 20)	/* Bytes of frames waiting to be written. */
+#define RECORD_FRAME_MAX (1 << 16)	/* Largest frame recorded, in bytes. */
+#define RECORD_POLL_NSEC 10000000	/* Writer's nap when there's nothing to do. */
+
+/* Whether the session is being recorded. */
+
+extern int recording;
+
+/* Record the session to path, written as it goes and completed at exit.
+   Return 0 on success or -1 on error. */
+
+int record_open (const char *path);
+
+/* Note the size of the terminal, before the first frame and whenever it
+   changes. Not to be called within a game step: it may allocate. */
+
+void record_resize (int rows, int cols);
+
+/* Record what is on the screen now, as ncurses knows it: only the cells
+   which changed since the last frame recorded. */
+
+void record_frame (void);
+
+#endif /* RECORD_H */
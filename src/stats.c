@@ -0,0 +1,83 @@
+/* stats.c - Live performance counters.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <config.h>
+
+#include "utils.h"
+#include "stats.h"
+
+static stats_t private_stats;	/* Fallback if shared memory is unavailable. */
+
+stats_t *stats = &private_stats;
+
+static char shm_name[64];	/* Name of the shared object, if any. */
+
+/* Remove the shared counters page. It stays mapped until the process is
+   gone, since other threads may still count on it while exit runs. */
+
+static void stats_close (void)
+{
+  if (stats != &private_stats)
+    shm_unlink (shm_name);
+}
+
+/* Create and map the shared counters page. */
+
+int stats_open (void)
+{
+  int fd;
+  stats_t *page;
+
+  sprintf (shm_name, STATS_SHM_NAME, (int) getpid());
+
+  fd = shm_open (shm_name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+    return -1;
+
+  if (ftruncate (fd, sizeof (*page)) < 0)
+    {
+      close (fd);
+      shm_unlink (shm_name);
+      return -1;
+    }
+
+  page = mmap (NULL, sizeof (*page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (page == MAP_FAILED)
+    {
+      shm_unlink (shm_name);
+      return -1;
+    }
+
+  page->version = STATS_VERSION;
+  page->pid = getpid();
+  page->started = monotonic_usec();
+  __atomic_store_n (&page->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+
+  stats = page;
+  atexit (stats_close);
+  return 0;
+}
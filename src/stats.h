@@ -0,0 +1,80 @@
+/* stats.h - Live performance counters.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+/* The game publishes its counters in a POSIX shared memory object named
+   after its pid, so that ttsnake-stat may sample any running session. */
+
+#define STATS_SHM_NAME "/" ALT_SHORT_NAME "-%d" /* Formatted with the pid. */
+#define STATS_MAGIC    0x74747374	       /* "ttst" */
+#define STATS_VERSION  4
+
+/* The counters page. Every counter only ever grows, and is updated with
+   relaxed atomic adds: no locks, and no ordering with anything else, even
+   when the games of a host add to it from many threads (see host.c).
+   Readers take deltas. */
+
+typedef struct stats_st
+{
+  uint32_t magic;		/* STATS_MAGIC, set once the page is ready. */
+  uint32_t version;		/* STATS_VERSION. */
+  int32_t  pid;			/* Process publishing the counters. */
+  uint32_t reserved;
+  uint64_t started;		/* CLOCK_MONOTONIC time (usec) of creation. */
+
+  uint64_t ticks;		/* Game steps computed by advance(). */
+  uint64_t frames;		/* Frames drawn on the screen. */
+  uint64_t bytes_out;		/* Bytes written to the terminal. */
+  uint64_t advance_usec;	/* Total time spent in advance(). */
+  uint64_t render_usec;		/* Total time spent drawing frames. */
+  uint64_t overshoot_usec;	/* Total time slept beyond the frame delay. */
+  uint64_t sleeps;		/* Frame delays applied. */
+  uint64_t input_events;	/* Keys read from the player. */
+  uint64_t frames_skipped;	/* Game steps not drawn due to back-pressure. */
+  uint64_t write_block_usec;	/* Total time the terminal took to take output. */
+  uint64_t frames_unrecorded;	/* Frames dropped from the recording. */
+  uint64_t writes_out;		/* Write calls to the terminal. */
+} stats_t;
+
+/* The counters of this process. Always valid: if the shared object can't
+   be created, it points to a private page which nobody else sees. */
+
+extern stats_t *stats;
+
+/* Add n to a counter. */
+
+#define STAT_ADD(field, n) \
+  __atomic_fetch_add (&stats->field, (n), __ATOMIC_RELAXED)
+
+/* Read a counter from a (possibly foreign) counters page. */
+
+#define STAT_GET(page, field) \
+  __atomic_load_n (&(page)->field, __ATOMIC_RELAXED)
+
+/* Create and map the shared counters page. Return 0 on success, or -1 if
+   the counters are kept private. The object is removed at exit. */
+
+int stats_open (void);
+
+#endif /* STATS_H */
@@ -0,0 +1,143 @@
+/* trace.c - Per-frame phase tracing.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <config.h>
+
+#include "utils.h"
+#include "trace.h"
+
+/* One complete ('X') trace event. */
+
+typedef struct span_st
+{
+  const char *name;		/* Phase name (static string). */
+  uint64_t start;		/* Begin time (usec). */
+  uint32_t duration;		/* Length (usec). */
+  uint32_t tid;			/* 1 for the main thread, 2 for others. */
+} span_t;
+
+int tracing;
+
+static span_t *spans;		/* Preallocated span buffer. */
+static uint64_t nspans;		/* Spans claimed (may exceed the buffer). */
+static char *trace_path;	/* Where to write the trace at exit. */
+static pthread_t main_thread;	/* Thread which opened the trace. */
+
+/* Write the recorded spans to trace_path. */
+
+static void trace_close (void)
+{
+  FILE *file;
+  const char *name;
+  uint64_t i, n, dropped;
+  int pid;
+
+  tracing = 0;
+
+  n = __atomic_load_n (&nspans, __ATOMIC_ACQUIRE);
+  dropped = n > TRACE_MAX_SPANS ? n - TRACE_MAX_SPANS : 0;
+  n -= dropped;
+
+  file = fopen (trace_path, "w");
+  if (!file)
+    {
+      perror (trace_path);
+      return;
+    }
+
+  pid = getpid();
+
+  fprintf (file, "{\"traceEvents\":[\n");
+  fprintf (file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,"
+	   "\"args\":{\"name\":\"game\"}},\n", pid);
+  fprintf (file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":2,"
+	   "\"args\":{\"name\":\"input\"}}", pid);
+
+  /* A span still being filled in by another thread is skipped: its name
+     is stored last (see trace_span). */
+
+  for (i = 0; i < n; i++)
+    {
+      name = __atomic_load_n (&spans[i].name, __ATOMIC_ACQUIRE);
+      if (name)
+	fprintf (file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%u,"
+		 "\"pid\":%d,\"tid\":%u}",
+		 name, (unsigned long) spans[i].start, spans[i].duration,
+		 pid, spans[i].tid);
+    }
+
+  fprintf (file, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"version\":\""
+	   PACKAGE_STRING "\",\"dropped_spans\":\"%lu\"}}\n",
+	   (unsigned long) dropped);
+
+  fclose (file);
+}
+
+/* Start tracing. */
+
+int trace_open (const char *path)
+{
+  spans = malloc (sizeof (*spans) * TRACE_MAX_SPANS);
+  trace_path = malloc (strlen (path) + 1);
+  if (!spans || !trace_path)
+    {
+      free (spans);
+      free (trace_path);
+      return -1;
+    }
+
+  /* Touch the whole buffer now, so that page faults don't show up as
+     stalls in the middle of the game. */
+
+  memset (spans, 0, sizeof (*spans) * TRACE_MAX_SPANS);
+  strcpy (trace_path, path);
+
+  main_thread = pthread_self();
+  tracing = 1;
+  atexit (trace_close);
+  return 0;
+}
+
+/* Record a span. The slot is claimed with an atomic increment, so
+   concurrent threads never need a lock, and published by storing its
+   name, once the rest of it is filled in. */
+
+void trace_span (const char *name, uint64_t start)
+{
+  uint64_t i, now;
+
+  if (!tracing)
+    return;
+
+  now = monotonic_usec();
+  i = __atomic_fetch_add (&nspans, 1, __ATOMIC_ACQ_REL);
+  if (i >= TRACE_MAX_SPANS)
+    return;
+
+  spans[i].start = start;
+  spans[i].duration = now - start;
+  spans[i].tid = pthread_equal (pthread_self(), main_thread) ? 1 : 2;
+  __atomic_store_n (&spans[i].name, name, __ATOMIC_RELEASE);
+}
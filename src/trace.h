@@ -0,0 +1,45 @@
+/* trace.h - Per-frame phase tracing.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAX_SPANS (1 << 19) /* Spans kept in memory (16 MiB). */
+
+/* Whether tracing is enabled. */
+
+extern int tracing;
+
+/* Start tracing: preallocate the span buffer and arrange for it to be
+   written to path, in Chrome's trace-event JSON format, at exit. Return 0
+   on success or -1 on error. */
+
+int trace_open (const char *path);
+
+/* Record a span named name (a string literal), from start (as returned by
+   monotonic_usec) up to now. Spans which don't fit in the buffer are
+   counted and dropped. Safe to call from any thread; a no-op if tracing is
+   disabled. */
+
+void trace_span (const char *name, uint64_t start);
+
+#endif /* TRACE_H */
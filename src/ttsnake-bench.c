@@ -0,0 +1,780 @@
+/* ttsnake-bench.c - Measure what the game puts on the terminal.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE		/* For forkpty() and memmem(). */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <getopt.h>
+#include <pty.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <config.h>
+
+#include "stats.h"
+
+#define DEFAULT_ROWS  46	/* Terminal geometry the game runs in. */
+#define DEFAULT_COLS  120
+#define DEFAULT_TICKS 300	/* Game steps measured. */
+#define TURN_EVERY    10	/* Game steps between turns of the snake. */
+#define MARKER "Press 'p'"	/* Text showing the intro is over. */
+#define POLL_MSEC 1
+
+#define SCREEN_ROWS 256		/* Largest terminal emulated. */
+#define SCREEN_COLS 512
+#define HEAD '0'		/* The snake's head, as drawn by the game. */
+#define BORDER '|'		/* What board rows start with. */
+#define MAX_JUMP 9		/* Cells the head may move between frames. */
+#define STRAIGHT 4		/* Game steps ahead between turns measured. */
+#define TIMEOUT 20		/* Game steps a turn is waited for. */
+#define MAX_TURNS 100000	/* Most turns measured. */
+
+/* Totals at some point of the run. */
+
+typedef struct sample_st
+{
+  uint64_t usec;		/* Wall time. */
+  uint64_t bytes;		/* Bytes read from the terminal. */
+  uint64_t frames;		/* Frames the game drew. */
+  uint64_t writes;		/* Write calls the game made to the terminal. */
+} sample_t;
+
+int master;			/* Our side of the pseudo-terminal. */
+pid_t game;			/* The game process. */
+stats_t *page;			/* Its counters. */
+uint64_t bytes;			/* Bytes read from it so far. */
+char tail[sizeof (MARKER) - 1]; /* Last bytes read, to find the marker. */
+size_t tail_length;
+int marked;			/* Whether the marker was seen. */
+
+uint64_t *taken;		/* How long each turn took to show. */
+int seen_turns, lost_turns;
+uint64_t step_usec;		/* How long a game step takes. */
+
+/* The terminal as the game drew it. Only what ncurses is seen to send
+   for xterm-256color is emulated: cursor motion, erasing, repeating and
+   scrolling, while attributes are ignored. */
+
+struct
+{
+  char cell[SCREEN_ROWS][SCREEN_COLS];
+  int rows, cols;
+  int y, x, saved_y, saved_x;	/* Cursor. */
+  int top, bottom;		/* Scrolling region. */
+  char last;			/* Last char printed, for REP. */
+  int state;			/* Where in an escape sequence. */
+  int param[16], nparams;	/* Numbers of a control sequence. */
+} screen;
+
+enum {GROUND, ESCAPE, CSI, CHARSET};
+
+typedef struct point_st
+{
+  int y, x;
+} point_t;
+
+/* Shows help screen. Exit code is -1 if isError is set to true */
+
+void show_help (char isError)
+{
+  fprintf (isError ? stderr : stdout, "\
+Usage: " ALT_SHORT_NAME "-bench [options] [-- game options]\n\n\
+  Run the game in a pseudo-terminal, play the intro and some game steps,\n\
+  and report what was written to the terminal per frame drawn.\n\n\
+  Options\n\n\
+  -b, --binary     Game binary to run (default ./" BIN_NAME ".bin)\n\
+  -g, --geometry   Terminal size, as ROWSxCOLS (default 46x120)\n\
+  -n, --ticks      Game steps to measure (default 300)\n\
+  -i, --skip-intro Skip the intro\n\
+  -l, --latency N  Instead of game steps, measure how long N turns of the\n\
+                   snake take to show, from the key press\n\
+  -h, --help       Display this information message.\n\
+  -v, --version    Outputs the program version\n");
+  exit (isError ? -1 : 0);
+}
+
+uint64_t now_usec (void)
+{
+  struct timespec now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec * (uint64_t) 1000000 + now.tv_nsec / 1000;
+}
+
+/* Clamp the cursor to the screen. */
+
+void clamp (void)
+{
+  screen.y = screen.y < 0 ? 0 : screen.y >= screen.rows ? screen.rows - 1 : screen.y;
+  screen.x = screen.x < 0 ? 0 : screen.x > screen.cols ? screen.cols : screen.x;
+}
+
+/* Blank the cells from y, x to y, x+n of one row. */
+
+void erase (int y, int x, int n)
+{
+  if (x + n > screen.cols)
+    n = screen.cols - x;
+  if (n > 0)
+    memset (&screen.cell[y][x], ' ', n);
+}
+
+/* Scroll the rows from first to the bottom of the scrolling region by n
+   rows: up if n is positive, down otherwise. Rows brought in are blank. */
+
+void scroll (int first, int n)
+{
+  int i, count = screen.bottom - first + 1;
+
+  if (first < screen.top || first > screen.bottom)
+    return;
+  if (n > count)
+    n = count;
+  if (n < -count)
+    n = -count;
+
+  if (n > 0)
+    {
+      memmove (screen.cell[first], screen.cell[first + n], (count - n) * SCREEN_COLS);
+      for (i = screen.bottom - n + 1; i <= screen.bottom; i++)
+	erase (i, 0, screen.cols);
+    }
+  else if (n < 0)
+    {
+      memmove (screen.cell[first - n], screen.cell[first], (count + n) * SCREEN_COLS);
+      for (i = first; i < first - n; i++)
+	erase (i, 0, screen.cols);
+    }
+}
+
+/* Move the cursor down a row, scrolling at the bottom of the region. */
+
+void line_feed (void)
+{
+  if (screen.y == screen.bottom)
+    scroll (screen.top, 1);
+  else if (screen.y < screen.rows - 1)
+    screen.y++;
+}
+
+/* Print c at the cursor. A char printed in the last column leaves the
+   cursor past it, so that the next one goes to the next row. */
+
+void print (char c)
+{
+  if (screen.x == screen.cols)
+    {
+      screen.x = 0;
+      line_feed ();
+    }
+  screen.cell[screen.y][screen.x++] = c;
+  screen.last = c;
+}
+
+/* Carry out a control sequence. */
+
+void control (char final)
+{
+  int i, n = screen.nparams ? screen.param[0] : 0, m = n ? n : 1;
+
+  switch (final)
+    {
+    case 'H':
+    case 'f':
+      screen.y = m - 1;
+      screen.x = (screen.nparams > 1 && screen.param[1]) ? screen.param[1] - 1 : 0;
+      break;
+    case 'A':
+      screen.y -= m;
+      break;
+    case 'B':
+      screen.y += m;
+      break;
+    case 'C':
+      screen.x += m;
+      break;
+    case 'D':
+      screen.x -= m;
+      break;
+    case 'G':
+    case '`':
+      screen.x = m - 1;
+      break;
+    case 'd':
+      screen.y = m - 1;
+      break;
+    case 'K':
+      if (n == 0)
+	erase (screen.y, screen.x, screen.cols);
+      else
+	erase (screen.y, 0, n == 1 ? screen.x + 1 : screen.cols);
+      break;
+    case 'J':
+      if (n == 2)
+	for (i = 0; i < screen.rows; i++)
+	  erase (i, 0, screen.cols);
+      else
+	for (i = screen.y + 1; i < screen.rows; i++)
+	  erase (i, 0, screen.cols);
+      if (n == 0)
+	erase (screen.y, screen.x, screen.cols);
+      break;
+    case 'X':
+      erase (screen.y, screen.x, m);
+      break;
+    case 'b':
+      for (i = 0; i < m; i++)
+	print (screen.last);
+      break;
+    case 'r':
+      screen.top = m - 1;
+      screen.bottom = (screen.nparams > 1 && screen.param[1]) ? screen.param[1] - 1 : screen.rows - 1;
+      if (screen.bottom >= screen.rows || screen.top >= screen.bottom)
+	{
+	  screen.top = 0;
+	  screen.bottom = screen.rows - 1;
+	}
+      screen.y = screen.x = 0;
+      break;
+    case 'S':
+      scroll (screen.top, m);
+      break;
+    case 'T':
+      scroll (screen.top, -m);
+      break;
+    case 'M':
+      scroll (screen.y, m);
+      break;
+    case 'L':
+      scroll (screen.y, -m);
+      break;
+    case 'P':
+      if (screen.x + m < screen.cols)
+	memmove (&screen.cell[screen.y][screen.x], &screen.cell[screen.y][screen.x + m],
+		 screen.cols - screen.x - m);
+      erase (screen.y, screen.cols - m, m);
+      break;
+    case '@':
+      if (screen.x + m < screen.cols)
+	memmove (&screen.cell[screen.y][screen.x + m], &screen.cell[screen.y][screen.x],
+		 screen.cols - screen.x - m);
+      erase (screen.y, screen.x, m);
+      break;
+    default:
+      break;			/* Attributes, modes... */
+    }
+  clamp ();
+}
+
+/* Have the screen take the bytes the game wrote. */
+
+void feed (const char *bytes, size_t count)
+{
+  unsigned char c;
+  size_t i;
+
+  for (i = 0; i < count; i++)
+    {
+      c = bytes[i];
+      switch (screen.state)
+	{
+	case ESCAPE:
+	  screen.state = GROUND;
+	  if (c == '[')
+	    {
+	      screen.state = CSI;
+	      screen.nparams = 0;
+	      screen.param[0] = 0;
+	    }
+	  else if (c == '(' || c == ')')
+	    screen.state = CHARSET;
+	  else if (c == '7')
+	    {
+	      screen.saved_y = screen.y;
+	      screen.saved_x = screen.x;
+	    }
+	  else if (c == '8')
+	    {
+	      screen.y = screen.saved_y;
+	      screen.x = screen.saved_x;
+	    }
+	  else if (c == 'M' && screen.y == screen.top)
+	    scroll (screen.top, -1);
+	  else if (c == 'M' && screen.y > 0)
+	    screen.y--;
+	  else if (c == 'D')
+	    line_feed ();
+	  break;
+	case CSI:
+	  if (c >= '0' && c <= '9')
+	    {
+	      if (!screen.nparams)
+		screen.nparams = 1;
+	      screen.param[screen.nparams - 1] = screen.param[screen.nparams - 1] * 10 + c - '0';
+	    }
+	  else if (c == ';')
+	    {
+	      if (!screen.nparams)
+		screen.nparams = 1;
+	      if (screen.nparams < 16)
+		screen.param[screen.nparams++] = 0;
+	    }
+	  else if (c >= 0x40 && c <= 0x7e)
+	    {
+	      screen.state = GROUND;
+	      control (c);
+	    }
+	  break;			/* '?', '>'... are ignored. */
+	case CHARSET:
+	  screen.state = GROUND;
+	  break;
+	default:
+	  if (c == 0x1b)
+	    screen.state = ESCAPE;
+	  else if (c == '\r')
+	    screen.x = 0;
+	  else if (c == '\n')
+	    line_feed ();
+	  else if (c == '\b')
+	    screen.x -= screen.x > 0;
+	  else if (c == '\t')
+	    screen.x = (screen.x / 8 + 1) * 8 < screen.cols ? (screen.x / 8 + 1) * 8 : screen.cols - 1;
+	  else if (c >= ' ' && c < 0x7f)
+	    print (c);
+	  else if (c >= 0xc0)
+	    print ('?');		/* One wide char, whichever it is. */
+	}
+    }
+}
+
+/* Find the snake's head on the board. Return 0 if it isn't there, or
+   if it can't be told apart. */
+
+int find_head (point_t *head)
+{
+  int y, x, found = 0;
+
+  for (y = 0; y < screen.rows; y++)
+    {
+      for (x = 0; x < screen.cols && screen.cell[y][x] == ' '; x++)
+	;
+      if (x == screen.cols || screen.cell[y][x] != BORDER)
+	continue;
+      for (; x < screen.cols; x++)
+	if (screen.cell[y][x] == HEAD)
+	  {
+	    head->y = y;
+	    head->x = x;
+	    found++;
+	  }
+    }
+  return found == 1;
+}
+
+void take (sample_t *sample)
+{
+  sample->usec = now_usec();
+  sample->bytes = bytes;
+  sample->frames = page ? STAT_GET (page, frames) : 0;
+  sample->writes = page ? STAT_GET (page, writes_out) : 0;
+}
+
+/* Map the counters page of the game, once it is there: the game creates
+   it, sizes it and fills it in, in that order. Until then, leave it for
+   the next try. */
+
+void attach (void)
+{
+  char name[64];
+  struct stat status;
+  int fd;
+
+  sprintf (name, STATS_SHM_NAME, (int) game);
+  fd = shm_open (name, O_RDONLY, 0);
+  if (fd < 0)
+    return;
+
+  if ((fstat (fd, &status) < 0) || (status.st_size < (off_t) sizeof (*page)))
+    {
+      close (fd);
+      return;
+    }
+
+  page = mmap (NULL, sizeof (*page), PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (page == MAP_FAILED)
+    page = NULL;
+  else if (STAT_GET (page, magic) != STATS_MAGIC)
+    {
+      munmap (page, sizeof (*page));
+      page = NULL;
+    }
+}
+
+/* Read whatever the game wrote, waiting up to a while for it. Return -1
+   once the game is gone. */
+
+int drain (int msec)
+{
+  static char buffer[sizeof (tail) + (1 << 16)];
+  struct pollfd fds;
+  ssize_t count;
+  size_t keep;
+
+  fds.fd = master;
+  fds.events = POLLIN;
+
+  if (poll (&fds, 1, msec) <= 0)
+    return 0;
+
+  /* Read after the tail of the last read, so as to find the marker even
+     if it was split. */
+
+  memcpy (buffer, tail, tail_length);
+  count = read (master, buffer + tail_length, sizeof (buffer) - tail_length);
+  if (count <= 0)
+    return -1;
+  bytes += count;
+
+  feed (buffer + tail_length, count);
+  count += tail_length;
+  if (!marked)
+    marked = memmem (buffer, count, MARKER, sizeof (tail)) != NULL;
+
+  keep = (size_t) count < sizeof (tail) ? (size_t) count : sizeof (tail);
+  memcpy (tail, buffer + count - keep, keep);
+  tail_length = keep;
+
+  if (!page)
+    attach ();
+  return 0;
+}
+
+void press (char key)
+{
+  if (write (master, &key, 1) < 0)
+    perror ("write");
+}
+
+/* Read the game's output until it is done with the given game step.
+   Return -1 if the game is gone. */
+
+int wait_ticks (uint64_t ticks)
+{
+  while (STAT_GET (page, ticks) < ticks)
+    if (drain (POLL_MSEC) < 0)
+      return -1;
+  return 0;
+}
+
+int compare (const void *a, const void *b)
+{
+  return *(const uint64_t *) a < *(const uint64_t *) b ? -1
+    : *(const uint64_t *) a > *(const uint64_t *) b;
+}
+
+/* Measure input-to-screen latency. Turn the snake clockwise, at a random
+   time within a game step, every few steps, and time how long it takes
+   from pressing the key until its head shows up on the screen going the
+   new way. Turns not seen in a while (e.g. the snake died) are counted as
+   lost, and the game is restarted. Return -1 if the game is gone. */
+
+int latency (int turns)
+{
+  static const char keys[] = "dsaw"; /* Right, down, left, up. */
+  static const int dy[] = {0, 1, 0, -1}, dx[] = {1, 0, -1, 0};
+  uint64_t start, ticks, pressed;
+  point_t from, head;
+  int way = 0, seen;
+
+  taken = malloc (turns * sizeof (*taken));
+  if (!taken)
+    return -1;
+
+  /* Time the game steps, as the game paces them. */
+
+  press ('p');
+  if (wait_ticks (STAT_GET (page, ticks) + 1) < 0)
+    return -1;
+  start = now_usec ();
+  ticks = STAT_GET (page, ticks);
+  if (wait_ticks (ticks + STRAIGHT * 2) < 0)
+    return -1;
+  step_usec = (now_usec () - start) / (STAT_GET (page, ticks) - ticks);
+
+  srand (start);
+  while (seen_turns < turns)
+    {
+      /* Go straight for a while, then wait for a random time within the
+	 step which just began. */
+
+      if (wait_ticks (STAT_GET (page, ticks) + STRAIGHT) < 0)
+	return -1;
+      start = now_usec () + rand () % step_usec;
+      while (now_usec () < start)
+	if (drain (POLL_MSEC) < 0)
+	  return -1;
+
+      if (!find_head (&from))
+	{
+	  press ('r');		/* Game over; start another. */
+	  way = 0;
+	  continue;
+	}
+
+      way = (way + 1) % 4;
+      press (keys[way]);
+      pressed = now_usec ();
+
+      ticks = STAT_GET (page, ticks);
+      seen = 0;
+      while (!seen && STAT_GET (page, ticks) < ticks + TIMEOUT)
+	{
+	  if (drain (POLL_MSEC) < 0)
+	    return -1;
+	  seen = find_head (&head)
+	    && (head.y - from.y) * dy[way] + (head.x - from.x) * dx[way] > 0
+	    && abs (head.y - from.y) + abs (head.x - from.x) <= MAX_JUMP;
+	}
+
+      if (seen)
+	taken[seen_turns++] = now_usec () - pressed;
+      else
+	{
+	  lost_turns++;
+	  press ('r');
+	  way = 0;
+	}
+    }
+
+  return 0;
+}
+
+/* Report the distribution of the latencies measured, in ms. */
+
+#define PERCENTILE(p) (taken[(seen_turns - 1) * (p) / 100] / 1000.0)
+
+void report_latency (void)
+{
+  qsort (taken, seen_turns, sizeof (*taken), compare);
+  printf ("%-8s %8s %8s %8s %8s %8s %8s %8s\n", "turns", "lost", "step_ms",
+	  "min_ms", "p50_ms", "p90_ms", "p99_ms", "max_ms");
+  printf ("%-8d %8d %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", seen_turns,
+	  lost_turns, step_usec / 1000.0, PERCENTILE (0), PERCENTILE (50),
+	  PERCENTILE (90), PERCENTILE (99), PERCENTILE (100));
+}
+
+void report (const char *phase, sample_t *from, sample_t *to)
+{
+  uint64_t frames = to->frames - from->frames;
+
+  if (!frames)
+    {
+      printf ("%-8s %8d\n", phase, 0);
+      return;
+    }
+  printf ("%-8s %8lu %10lu %9.0f %9.2f %9.0f\n", phase,
+	  (unsigned long) frames,
+	  (unsigned long) (to->bytes - from->bytes),
+	  (double) (to->bytes - from->bytes) / frames,
+	  (double) (to->writes - from->writes) / frames,
+	  (double) (to->usec - from->usec) / frames);
+}
+
+int main (int argc, char **argv)
+{
+  const struct option stoptions[] = {
+    {"binary", required_argument, 0, 'b'},
+    {"geometry", required_argument, 0, 'g'},
+    {"ticks", required_argument, 0, 'n'},
+    {"skip-intro", no_argument, 0, 'i'},
+    {"latency", required_argument, 0, 'l'},
+    {"help", no_argument, 0, 'h'},
+    {"version", no_argument, 0, 'v'},
+    {0, 0, 0, 0}};
+
+  const char turns[] = "sawd";	/* Clockwise, from heading right. */
+  char *binary = "./" BIN_NAME ".bin", **args;
+  int ticks = DEFAULT_TICKS, skip_intro = 0, probes = 0, opt, i, turn = 0;
+  uint64_t start_ticks, next_turn;
+  struct winsize size;
+  sample_t begin, intro, end;
+
+  size.ws_row = DEFAULT_ROWS;
+  size.ws_col = DEFAULT_COLS;
+  size.ws_xpixel = size.ws_ypixel = 0;
+
+  while ((opt = getopt_long (argc, argv, "b:g:n:il:hv", stoptions, NULL)) != -1)
+    {
+      switch (opt)
+	{
+	case 'b':
+	  binary = optarg;
+	  break;
+	case 'g':
+	  if (sscanf (optarg, "%hux%hu", &size.ws_row, &size.ws_col) != 2)
+	    show_help (1);
+	  break;
+	case 'n':
+	  ticks = atoi (optarg);
+	  break;
+	case 'i':
+	  skip_intro = 1;
+	  break;
+	case 'l':
+	  probes = atoi (optarg);
+	  if (probes < 1 || probes > MAX_TURNS)
+	    show_help (1);
+	  break;
+	case 'h':
+	  show_help (0);
+	  break;
+	case 'v':
+	  printf (PACKAGE_STRING "\n");
+	  exit (EXIT_SUCCESS);
+	  break;
+	default:
+	  show_help (1);
+	}
+    }
+  if (ticks < 1 || !size.ws_row || !size.ws_col
+      || size.ws_row > SCREEN_ROWS || size.ws_col > SCREEN_COLS)
+    show_help (1);
+
+  screen.rows = size.ws_row;
+  screen.cols = size.ws_col;
+  screen.bottom = screen.rows - 1;
+  memset (screen.cell, ' ', sizeof (screen.cell));
+
+  /* The game gets the binary name and whatever options follow ours. */
+
+  args = malloc ((argc - optind + 2) * sizeof (*args));
+  args[0] = binary;
+  for (i = optind; i < argc; i++)
+    args[i - optind + 1] = argv[i];
+  args[argc - optind + 1] = NULL;
+
+  game = forkpty (&master, NULL, NULL, &size);
+  if (game < 0)
+    {
+      perror ("forkpty");
+      return EXIT_FAILURE;
+    }
+  if (game == 0)
+    {
+      setenv ("TERM", "xterm-256color", 1); /* The same escapes every run. */
+      execv (binary, args);
+      perror (binary);
+      _exit (127);
+    }
+
+  take (&begin);
+
+  /* Intro: until the menu shows up. A key pressed before the intro is
+     on might be taken for something else, so it is skipped only once
+     its first frame is drawn. */
+
+  if (skip_intro)
+    {
+      while (!page || !STAT_GET (page, frames))
+	if (drain (POLL_MSEC) < 0)
+	  {
+	    fprintf (stderr, "The game is gone before its intro showed up.\n");
+	    return EXIT_FAILURE;
+	  }
+      press ('q');
+    }
+  while (!marked)
+    if (drain (POLL_MSEC) < 0)
+      {
+	fprintf (stderr, "The game is gone before its menu showed up.\n");
+	return EXIT_FAILURE;
+      }
+  take (&intro);
+
+  /* Game: steer in squares so as to last, until enough steps are done. */
+
+  if (!page)
+    {
+      fprintf (stderr, "Can't read the game counters.\n");
+      kill (game, SIGTERM);
+      return EXIT_FAILURE;
+    }
+
+  if (probes)
+    {
+      if (latency (probes) < 0)
+	{
+	  fprintf (stderr, "The game is gone before the turns were measured.\n");
+	  return EXIT_FAILURE;
+	}
+      ticks = 0;		/* Skip the game steps. */
+    }
+  else
+    press ('p');
+
+  start_ticks = STAT_GET (page, ticks);
+  next_turn = start_ticks + TURN_EVERY;
+  while (STAT_GET (page, ticks) < start_ticks + ticks)
+    {
+      if (drain (POLL_MSEC) < 0)
+	break;
+      if (STAT_GET (page, ticks) >= next_turn)
+	{
+	  press (turns[turn++ % 4]);
+	  next_turn += TURN_EVERY;
+	}
+    }
+  take (&end);
+
+  /* Quit, and take the output until the game is gone. */
+
+  press ('q');
+  while (drain (100) >= 0)
+    if (waitpid (game, NULL, WNOHANG) == game)
+      break;
+  waitpid (game, NULL, 0);
+
+  if (!skip_intro || !probes)
+    printf ("%-8s %8s %10s %9s %9s %9s\n", "phase", "frames", "bytes",
+	    "B/frame", "writes/f", "us/frame");
+  if (!skip_intro)
+    report ("intro", &begin, &intro);
+  if (!probes)
+    report ("game", &intro, &end);
+  else
+    {
+      if (!skip_intro)
+	putchar ('\n');
+      report_latency ();
+    }
+
+  munmap (page, sizeof (*page));
+  free (taken);
+  free (args);
+  return EXIT_SUCCESS;
+}
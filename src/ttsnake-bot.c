@@ -0,0 +1,156 @@
+/* ttsnake-bot.c - An example snake controller.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Play the snake for the game, as in
+
+      ttsnake --controller ./ttsnake-bot
+
+   Keep a copy of the playfield from the observations (see controller.h),
+   and head for the nearest energy block, unless that is deadly. At the
+   end, report how much was read on the standard error. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <config.h>
+
+#include "controller.h"
+
+#define BLANK ' '
+
+/* Whether a cell holding c is deadly, as the game's DEADLY(). */
+
+#define DEADLY(c) ((c) == 'x' || (c) == '0' || (c) == 'o' || (c) == '@')
+
+char *board;			/* The playfield, row by row. */
+int rows, cols;
+
+obs_block_t blocks[OBS_MAX_BLOCKS];
+obs_cell_t cells[OBS_MAX_CELLS];
+
+/* Read exactly size bytes. Return 0, or -1 at the end of input. */
+
+int take (void *buffer, size_t size)
+{
+  ssize_t count;
+
+  while (size > 0)
+    {
+      count = read (STDIN_FILENO, buffer, size);
+      if (count <= 0)
+	return -1;
+      buffer = (char *) buffer + count;
+      size -= count;
+    }
+  return 0;
+}
+
+/* Whether the cell y, x is deadly. */
+
+int deadly (int y, int x)
+{
+  return y <= 0 || x <= 0 || y >= rows - 1 || x >= cols - 1
+    || DEADLY (board[y * cols + x]);
+}
+
+/* Choose where to go. */
+
+int choose (obs_header_t *header)
+{
+  static const int dy[4] = {-1, 0, 0, 1}, dx[4] = {0, 1, -1, 0};
+  int d, k, y, x, exits, distance, score, best = -1, best_score = 0;
+
+  for (d = 0; d < 4; d++)
+    {
+      if (d == 3 - header->direction)
+	continue;		/* Can't turn back. */
+      y = header->head_y + dy[d];
+      x = header->head_x + dx[d];
+      if (deadly (y, x))
+	continue;
+
+      /* Don't go where there's no way out. */
+
+      for (exits = 0, k = 0; k < 4; k++)
+	exits += !deadly (y + dy[k], x + dx[k]);
+
+      distance = rows + cols;
+      for (k = 0; k < header->nblocks; k++)
+	if (abs (blocks[k].y - y) + abs (blocks[k].x - x) < distance)
+	  distance = abs (blocks[k].y - y) + abs (blocks[k].x - x);
+
+      score = (exits > 1 ? 0 : exits ? 2 : 4) * (rows + cols) + distance;
+      if (best < 0 || score < best_score)
+	{
+	  best = d;
+	  best_score = score;
+	}
+    }
+
+  return best < 0 ? CTL_KEEP : best;
+}
+
+int main (void)
+{
+  obs_header_t header;
+  unsigned long observations = 0, resyncs = 0, bytes = 0;
+  unsigned char answer;
+  unsigned int i;
+
+  while (take (&header, sizeof (header)) == 0)
+    {
+      if (take (blocks, header.nblocks * sizeof (*blocks)) < 0
+	  || take (cells, header.ncells * sizeof (*cells)) < 0)
+	break;
+
+      observations++;
+      bytes += sizeof (header) + header.nblocks * sizeof (*blocks)
+	+ header.ncells * sizeof (*cells);
+
+      if (header.flags & OBS_RESYNC)
+	{
+	  resyncs++;
+	  if (header.rows != rows || header.cols != cols)
+	    {
+	      rows = header.rows;
+	      cols = header.cols;
+	      free (board);
+	      board = malloc ((size_t) rows * cols);
+	      if (!board)
+		return EXIT_FAILURE;
+	    }
+	  memset (board, BLANK, (size_t) rows * cols);
+	}
+
+      for (i = 0; i < header.ncells; i++)
+	board[cells[i].y * cols + cells[i].x] = cells[i].c;
+
+      answer = choose (&header);
+      if (write (STDOUT_FILENO, &answer, 1) != 1)
+	break;
+    }
+
+  if (observations)
+    fprintf (stderr, "%lu observations, %lu resyncs, %.1f bytes each\n",
+	     observations, resyncs, (double) bytes / observations);
+  free (board);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,282 @@
+/* ttsnake-stat.c - Report performance counters of running game sessions.
+
+   Copyright (c) 2021 - Monaco F. J. <monaco@usp.br>
+
+   This file is part of TexTronSnake
+
+   TexTronSnake is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <time.h>
+#include <getopt.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <config.h>
+
+#include "stats.h"
+
+#define SHM_DIR "/dev/shm"	/* Where shared memory objects are listed. */
+#define HEADER_EVERY 20		/* Repeat the header every so many lines. */
+#define ATTACH_TRIES 10		/* Tries to read a session just started, */
+#define ATTACH_NSEC  100000000	/* so long apart. */
+
+/* Shows help screen. Exit code is -1 if isError is set to true */
+
+void show_help (char isError)
+{
+  fprintf (isError ? stderr : stdout, "\
+Usage: " ALT_SHORT_NAME "-stat [options] [interval [count]]\n\n\
+  Report performance counters of a running game session every interval\n\
+  seconds (default 1), count times (default forever). The first line\n\
+  reports averages since the session started.\n\n\
+  Options\n\n\
+  -p, --pid        Session (process id) to report. Needed if more than one\n\
+                   session is running.\n\
+  -h, --help       Display this information message.\n\
+  -v, --version    Outputs the program version\n");
+  exit (isError ? -1 : 0);
+}
+
+/* Find the only running session and return its pid. Stale objects left
+   behind by sessions which didn't exit cleanly (e.g. which crashed) are
+   removed. Return 0 if there is none, or -1 if there are many. */
+
+int find_session (void)
+{
+  DIR *dir;
+  struct dirent *entry;
+  char name[64];
+  int pid, found = 0;
+
+  dir = opendir (SHM_DIR);
+  if (!dir)
+    return 0;
+
+  while ((entry = readdir (dir)))
+    {
+      if (sscanf (entry->d_name, ALT_SHORT_NAME "-%d", &pid) != 1)
+	continue;
+      if (kill (pid, 0) < 0)
+	{
+	  if (errno == ESRCH)
+	    {
+	      sprintf (name, STATS_SHM_NAME, pid);
+	      shm_unlink (name);
+	    }
+	  continue;
+	}
+      if (found)
+	{
+	  fprintf (stderr, "Many sessions running (%d, %d...); choose one with -p.\n",
+		   found, pid);
+	  closedir (dir);
+	  return -1;
+	}
+      found = pid;
+    }
+
+  closedir (dir);
+  return found;
+}
+
+/* Map the counters page of the given session, read-only. A session
+   which has just started may not have sized its page yet, or filled it
+   in; then return NULL, as for no session. */
+
+stats_t *attach (int pid)
+{
+  char name[64];
+  int fd;
+  struct stat status;
+  stats_t *page;
+
+  sprintf (name, STATS_SHM_NAME, pid);
+
+  fd = shm_open (name, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+
+  if ((fstat (fd, &status) < 0) || (status.st_size < (off_t) sizeof (*page)))
+    {
+      close (fd);
+      return NULL;
+    }
+
+  page = mmap (NULL, sizeof (*page), PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (page == MAP_FAILED)
+    return NULL;
+
+  if ((STAT_GET (page, magic) != STATS_MAGIC) || (page->version != STATS_VERSION))
+    {
+      munmap (page, sizeof (*page));
+      return NULL;
+    }
+
+  return page;
+}
+
+/* Take a snapshot of all counters. */
+
+void sample (stats_t *page, stats_t *snap)
+{
+  snap->ticks = STAT_GET (page, ticks);
+  snap->frames = STAT_GET (page, frames);
+  snap->bytes_out = STAT_GET (page, bytes_out);
+  snap->advance_usec = STAT_GET (page, advance_usec);
+  snap->render_usec = STAT_GET (page, render_usec);
+  snap->overshoot_usec = STAT_GET (page, overshoot_usec);
+  snap->sleeps = STAT_GET (page, sleeps);
+  snap->input_events = STAT_GET (page, input_events);
+  snap->frames_skipped = STAT_GET (page, frames_skipped);
+  snap->write_block_usec = STAT_GET (page, write_block_usec);
+  snap->frames_unrecorded = STAT_GET (page, frames_unrecorded);
+}
+
+/* Average of total over count, or zero. */
+
+#define AVG(total, count) ((count) ? (double) (total) / (count) : 0.0)
+
+/* Print the rates between two snapshots taken seconds apart. */
+
+void report (stats_t *new, stats_t *old, double seconds)
+{
+  uint64_t ticks, frames, sleeps;
+
+  ticks = new->ticks - old->ticks;
+  frames = new->frames - old->frames;
+  sleeps = new->sleeps - old->sleeps;
+
+  printf ("%8.1f %8.1f %8.1f %9.1f %8.0f %8.1f %8.1f %8.1f %8.0f %6lu %6lu\n",
+	  ticks / seconds,
+	  frames / seconds,
+	  (new->frames_skipped - old->frames_skipped) / seconds,
+	  (new->bytes_out - old->bytes_out) / seconds / 1024,
+	  AVG (new->bytes_out - old->bytes_out, frames),
+	  AVG (new->advance_usec - old->advance_usec, ticks),
+	  AVG (new->render_usec - old->render_usec, frames),
+	  AVG (new->write_block_usec - old->write_block_usec, frames),
+	  AVG (new->overshoot_usec - old->overshoot_usec, sleeps),
+	  (unsigned long) (new->input_events - old->input_events),
+	  (unsigned long) (new->frames_unrecorded - old->frames_unrecorded));
+  fflush (stdout);
+}
+
+int main (int argc, char **argv)
+{
+  const struct option stoptions[] = {
+    {"pid", required_argument, 0, 'p'},
+    {"help", no_argument, 0, 'h'},
+    {"version", no_argument, 0, 'v'},
+    {0, 0, 0, 0}};
+
+  int pid = 0, interval = 1, count = -1, lines, opt, tries;
+  stats_t *page, old, new;
+  struct timespec how_long, now;
+
+  while ((opt = getopt_long (argc, argv, "p:hv", stoptions, NULL)) != -1)
+    {
+      switch (opt)
+	{
+	case 'p':
+	  pid = atoi (optarg);
+	  break;
+	case 'h':
+	  show_help (0);
+	  break;
+	case 'v':
+	  printf (PACKAGE_STRING "\n");
+	  exit (EXIT_SUCCESS);
+	  break;
+	default:
+	  show_help (1);
+	}
+    }
+
+  if (optind < argc)
+    interval = atoi (argv[optind++]);
+  if (optind < argc)
+    count = atoi (argv[optind++]);
+  if (interval < 1)
+    show_help (1);
+
+  if (!pid)
+    pid = find_session ();
+  if (pid < 0)
+    return EXIT_FAILURE;
+  if (!pid)
+    {
+      fprintf (stderr, "No game session running.\n");
+      return EXIT_FAILURE;
+    }
+
+  how_long.tv_sec = 0;
+  how_long.tv_nsec = ATTACH_NSEC;
+  for (tries = 1; !(page = attach (pid)) && tries < ATTACH_TRIES; tries++)
+    nanosleep (&how_long, NULL);
+  if (!page)
+    {
+      fprintf (stderr, "Can't read counters of session %d.\n", pid);
+      return EXIT_FAILURE;
+    }
+
+  /* The first report covers the whole session, like vmstat's. */
+
+  memset (&old, 0, sizeof (old));
+  sample (page, &new);
+
+  how_long.tv_sec = interval;
+  how_long.tv_nsec = 0;
+
+  for (lines = 0; count != 0; lines++)
+    {
+      if (lines % HEADER_EVERY == 0)
+	printf ("%8s %8s %8s %9s %8s %8s %8s %8s %8s %6s %6s\n",
+		"ticks/s", "frames/s", "skips/s", "KiB/s", "B/frame",
+		"adv_us", "draw_us", "write_us", "late_us", "keys", "unrec");
+
+      if (lines == 0)
+	{
+	  clock_gettime (CLOCK_MONOTONIC, &now);
+	  report (&new, &old, (now.tv_sec * 1E6 + now.tv_nsec / 1E3
+			       - page->started) / 1E6);
+	}
+      else
+	report (&new, &old, interval);
+
+      if (count > 0)
+	count--;
+      if (count == 0)
+	break;
+
+      nanosleep (&how_long, NULL);
+
+      if (kill (pid, 0) < 0)
+	break;			/* Session is over. */
+
+      memcpy (&old, &new, sizeof (old));
+      sample (page, &new);
+    }
+
+  munmap (page, sizeof (*page));
+  return EXIT_SUCCESS;
+}
@@ -25,12 +25,26 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <pthread.h>
+#include <locale.h>
+#include <langinfo.h>
+#define NCURSES_WIDECHAR 1	/* Half blocks need the wide-character API. */
 #include <ncurses.h>
 #include <config.h>
 #include <getopt.h>
 #include <math.h>
+#include <assert.h>
+#include <sys/ioctl.h>
 
 #include "utils.h"
+#include "stats.h"
+#include "trace.h"
+#include "output.h"
+#include "arena.h"
+#include "controller.h"
+#include "record.h"
+#include "host.h"
+#include "ansi.h"
+#include "grid.h"
 
 /* Game defaults */
 
@@ -38,6 +52,12 @@
 
 #define LOWER_PANEL_ROWS 6 /* Rows occupied by the lower panel showing score, energy etc */
 
+#define SCENE_ROWS 80		/* Rows stored per scene (maximum board height). */
+#define TEXT_ROWS  40		/* Maximum board height unless in hires mode. */
+#define SCENE_COLS 90		/* Cols stored per scene (maximum board width). */
+#define MIN_ROWS   20		/* Smallest playable board height. */
+#define MIN_COLS   80		/* Smallest playable board width. */
+
 #define BLANK ' '		/* Blank-screen character. */
 
 #define BUFFSIZE 1024		/* Generic, auxilary buffer size. */
@@ -47,52 +67,104 @@
 #define SNAKE_TAIL	 '.'	 /* Character to draw the snake tail. */
 #define SNAKE_BODY       'x'     /* Character to draw the snake body. */
 #define SNAKE_HEAD	 '0'	 /* Character to draw the snake head. */
+#define RIVAL_BODY       'o'     /* Character to draw the arena rivals' body. */
+#define RIVAL_HEAD	 '@'	 /* Character to draw the arena rivals' head. */
 #define ENERGY_BLOCK     '+'	 /* Character to draw the energy block. */
 
+#define PAIR_SNAKE  1		/* Color pairs of the board cells. */
+#define PAIR_RIVAL  2
+#define PAIR_BLOCK  3
+#define PAIR_BORDER 4
+#define PAIR_HALF   8		/* First color pair of the half blocks. */
+
+#define UPPER_HALF L'\x2580'	/* Glyphs of the hires mode. */
+#define LOWER_HALF L'\x2584'
+#define FULL_BLOCK L'\x2588'
+#define EDGE '\0'		/* Stands for the borders in pixel rows. */
+
+#define MAX_RIVALS        500	/* Limit on the number of snakes in the arena. */
+#define RIVAL_LENGTH        4	/* Initial length of arena rivals. */
+#define MAX_RIVAL_LENGTH   32	/* Limit on how long arena rivals may grow. */
+#define MAX_SNAKE_LENGTH (SCENE_ROWS*SCENE_COLS) /* Limit on the player's length. */
+
 #define MAX_ENERGY_BLOCKS_LIMIT 50	/* Limit on the maximum number of energy blocks. */
-#define MAX_SNAKE_ENERGY (NCOLS+NROWS) /* Limit on how much energy the snake can store.*/
+#define SNACK_TRIES 64			/* Places tried for a new energy block. */
+#define RIVAL_TRIES 100			/* Places tried for a new rival... */
+#define RESPAWN_TRIES 4			/* ...and for one left out, at each step. */
+#define MAX_SNAKE_ENERGY (game->NCOLS+game->NROWS) /* Limit on how much energy the snake can store.*/
+
+#define MOVIE_FPS 30		/* Frame rate of the intro (see scenes/vidascii). */
+#define MOVIE_FRAME_USEC (1000000 / MOVIE_FPS)
+#define MOVIE_SEEK (2 * MOVIE_FPS) /* Frames skipped by each seek key. */
+#define MOVIE_END  (1 << 24)	   /* Seek as far as to the end of any movie. */
 
 #define MIN_GAME_DELAY 10200
 #define MAX_GAME_DELAY 2.5E5
 
-/* Global variables.*/
+#define REWIND_CHANGES (1 << 19) /* Changes kept for rewinding (6 MiB). */
 
-struct timeval beginning,	/* Time when game started. */
-  now,				/* Time now. */
-  before,			/* Time in the last frame. */
-  elapsed_last,			/* Elapsed time since last frame. */
-  elapsed_total,		/* Elapsed time since game baginning. */
-  elapsed_pause;		/* Elapsed time total when the player press pause. */
+#define MAX_WORLD   10000	/* Limit on the rows and cols of a large world. */
+#define CHUNK_BITS  6		/* Large worlds are kept in chunks of */
+#define CHUNK       (1 << CHUNK_BITS) /* CHUNK x CHUNK cells. */
+#define CHUNKS(n)   (((n) + CHUNK - 1) >> CHUNK_BITS) /* Chunks to span n cells. */
+#define CLAIM_SLOTS 1024	/* Room for the cells claimed by heads in a step
+				   (see advance); over twice MAX_RIVALS. */
 
-int NROWS; /* Number of rows in the game board */
-int NCOLS; /* Number of cols in the game board */
+/* Memory taken by a game: the snakes' bodies, the history, the chunk
+   directory of a large world, and some room for the arena's alignment. */
 
-int movie_delay;		/* How long between move scenes scenes. */
-int game_delay;			/* How long between game scenes. */
-int go_on; 			/* Whether to continue or to exit main loop.*/
-int player_lost;
-int restart_game; /* Whether the user has pressed to restart the game or not */
-int pause_game; /* Whether the user has pressed to pause the game or not */
-int on_settings; /* Whether the user is currently changing settings */
-int max_energy_blocks; /* Max number of energy blocks to display at once */
+#define GAME_MEMORY ((MAX_SNAKE_LENGTH + arena_rivals * MAX_RIVAL_LENGTH) * sizeof(pair_t) \
+		     + REWIND_CHANGES * sizeof(change_t) \
+		     + (world ? CHUNKS(game->WROWS) * CHUNKS(game->WCOLS) * sizeof(char *) : 0) + 64)
 
-enum settings_t {
-  ST_MAX_ENERGY = 0,    /* '= 0' ensures sequential counting from 0 */
-  ST_COUNT
+#define FRAME_BYTE_BUDGET 8192	/* Terminal output allowed per game step. */
+#define MAX_FRAME_SKIP    8	/* Most steps between frames, while the
+				   terminal keeps up (see playgame). */
+
+/* Terminal lines taken by the board. */
+
+#define BOARD_LINES (hires ? (game->NROWS + 1) / 2 : game->NROWS)
+
+/* Most terminal lines taken by the board and the panel. */
+
+#define MAX_LINES (((SCENE_ROWS + 1) / 2 > TEXT_ROWS ? (SCENE_ROWS + 1) / 2 : TEXT_ROWS) \
+		   + LOWER_PANEL_ROWS)
+
+/* In hires mode, each scene char is a pixel of one of these kinds. */
+
+enum pixel_t {
+  PX_BLANK = 0,
+  PX_ART,
+  PX_SNAKE,
+  PX_HEAD,
+  PX_RIVAL,
+  PX_RIVAL_HEAD,
+  PX_BLOCK,
+  PX_BORDER,
+  N_PIXELS
 };
 
-int which_setting; /* Which setting the player is currently configuring */
+/* How draw() shows a scene. */
 
-int block_count; 		/*Number of energy blocks collected */
+enum look_t {
+  LOOK_TEXT,			/* Plain text, e.g. the menus and the intro. */
+  LOOK_BOARD			/* The game board, colored by cell. */
+};
 
-WINDOW *main_window;
+/* Sides of the board drawn as borders. */
 
-/* SIGINT handler. The variable go_on controls the main loop. */
+enum border_t {
+  BORDER_TOP = 1,
+  BORDER_BOTTOM = 2,
+  BORDER_LEFT = 4,
+  BORDER_RIGHT = 8,
+  BORDER_ALL = 15
+};
 
-void quit ()
-{
-  go_on=0;
-}
+enum settings_t {
+  ST_MAX_ENERGY = 0,    /* '= 0' ensures sequential counting from 0 */
+  ST_COUNT
+};
 
 /* The snake data structrue. */
 
@@ -109,33 +181,242 @@ struct snake_st
 {
   pair_t head;			 /* The snake's head. */
   int length;			 /* The snake length (including head). */
-  pair_t *positions;	/* Position of each body part of the snake. */
+  pair_t *positions;	/* Position of each body part of the snake (circular). */
+  int tail;		/* Index of the tail in positions. */
+  int capacity;		/* Size of positions, i.e. maximum length. */
   direction_t direction, /* Movement direction. */
               lastdirection; /* Valid movement control */
   int energy; /*Energy of movements */
+  int alive;		/* Whether the snake is on the board. */
+  pair_t next;		/* Where the head goes in this step. */
+  int crashed;		/* Whether it crashed in this step. */
+  char head_char, body_char; /* How the snake is drawn. */
 };
 
-snake_t snake;			/* The snake istance. */
+/* Body parts are kept from tail to head in a circular buffer, so that
+   moving or growing the snake touches only its ends. PIECE(s,i) is the
+   i-th piece counting from the tail; the head is PIECE(s,s->length-1). */
+
+#define PIECE(s, i) ((s)->positions[((s)->tail + (i)) % (s)->capacity])
+
+/* All chars of one single scene. */
+
+typedef char scene_t[SCENE_ROWS][SCENE_COLS]; /* Maximum values. TODO: allocate dyamically */
+
+/* A number shown in the lower panel (see panel). */
+
+typedef struct field_st
+{
+  int row, col;			/* Where the number goes in the panel. */
+  int width;			/* Least columns it takes, right-aligned. */
+  int decimals;			/* Digits after the decimal point. */
+  int precision;		/* Least digits, as printf's. */
+  long value;			/* Number shown, times 10^decimals. */
+  int length;			/* Columns it took; -1 if not shown. */
+} field_t;
+
+enum {FIELD_ELAPSED, FIELD_FPS, FIELD_SCORE, FIELD_ENERGY, N_FIELDS};
+
+/* A change of the game, as kept in its history (see remember). */
+
+enum {CH_STEP, CH_CELL, CH_PIECE, CH_SNAKE, CH_BLOCK};
+
+typedef struct change_st
+{
+  unsigned char what;		/* What changed (CH_*). */
+  char c;			/* Cell: old char. Snake: old directions. */
+  unsigned short who;		/* Piece/snake/block: index. */
+  int a, b;			/* Cell: y, x. Others: old values. */
+} change_t;
+
+/* A cell claimed by a head, or left by a tail, in a step (see advance). */
+
+typedef struct claim_st
+{
+  unsigned int step;		/* Step in which the slot was used. */
+  pair_t cell;			/* Cell claimed or left. */
+  int claimer;			/* Snake which claimed it. */
+} claim_t;
+
+/* Options, the same for every game. */
+
+int arena_rivals;	/* How many computer snakes share the board (arena mode). */
+int monochrome;		/* Whether not to use colors. */
+int hires;		/* Whether to draw two rows per line, as half blocks. */
+int world;		/* Whether the playfield is a large world seen through the board. */
+int world_rows, world_cols; /* Size of the large world. */
+
+/* What the terminal of a hosted game shows, as of the last frame sent
+   (see send_frame): the game's grid, wherever it is on the terminal. */
+
+typedef struct sent_st
+{
+  cchar_t *cells;		/* The grid's, row by row. */
+  int top, left;		/* Where the grid is on the terminal. */
+  int cursor_y, cursor_x;	/* Where the cursor is; x is -1 if unknown. */
+  attr_t pen_attrs;		/* Attributes the terminal writes with. */
+  short pen_pair;
+  int fresh;			/* Whether the next frame clears the terminal. */
+} sent_t;
+
+/* The state of a game.
+
+   Each game keeps all of its state in a game_t of its own, and is played
+   by one thread at a time, so that a host may play many at once, one for
+   each player who joins (see host.c). The code is handed the game it
+   plays. */
+
+typedef struct game_st
+{
+  struct timeval beginning,	/* Time when game started. */
+    now,			/* Time now. */
+    before,			/* Time in the last frame. */
+    elapsed_last,		/* Elapsed time since last frame. */
+    elapsed_total,		/* Elapsed time since game baginning. */
+    elapsed_pause;		/* Elapsed time total when the player press pause. */
+
+  int NROWS; /* Number of rows in the game board */
+  int NCOLS; /* Number of cols in the game board */
+  int WROWS; /* Number of rows in the playfield (the board, unless in a large world) */
+  int WCOLS; /* Number of cols in the playfield */
+
+  int playing_movie;		/* Whether the intro is playing. */
+  int movie_seek;		/* Frames the player asked the intro to skip. */
+  int game_delay;		/* How long between game scenes. */
+  int go_on;			/* Whether to continue or to exit main loop.*/
+  int hung_up;			/* Whether the session was told to end. */
+  int player_lost;
+  int restart_game; /* Whether the user has pressed to restart the game or not */
+  int pause_game; /* Whether the user has pressed to pause the game or not */
+  int on_settings; /* Whether the user is currently changing settings */
+  int max_energy_blocks; /* Max number of energy blocks to display at once */
+  int frame_skip;		/* Draw one frame every frame_skip game steps. */
+  int rewind_steps;		/* Game steps the player asked to take back. */
+  int which_setting; /* Which setting the player is currently configuring */
+  int block_count;		/*Number of energy blocks collected */
+
+  volatile sig_atomic_t resized; /* Whether the terminal was resized. */
+  int too_small;		/* Whether the terminal can't hold the board. */
+
+  host_term_t *term;		/* The terminal, if hosted; NULL if ours. */
+  sent_t sent;			/* What the terminal shows, if hosted. */
+  grid_t grid;			/* What the game draws (see show_frame). */
+  WINDOW *main_window;		/* Where the grid is shown, unless hosted. */
+  int view_borders;		/* Sides of the view at the world's edges. */
+  field_t field[N_FIELDS];	/* Numbers shown in the panel. */
+  int panel_top;		/* Window row of the panel; -1 if not drawn. */
+  int panel_bars;		/* Cells of the energy bar shown. */
+
+  arena_t game_arena;		/* Memory of the current game. */
+  arena_t world_arena;		/* Chunks of the current large world. */
+
+  snake_t snakes[MAX_RIVALS + 1]; /* The player, then the arena rivals. */
+  int nsnakes;			/* How many snakes are in the game. */
+  snake_t *snake;		/* The player's snake. */
+
+  struct
+  {
+    int x;			/* Coordinate x of the energy block. */
+    int y;			/* Coordinate y of the energy block. */
+  } energy_block[MAX_ENERGY_BLOCKS_LIMIT]; /* Array of energy blocks. */
+
+  char **chunk;			/* Chunk directory of a large world, row by
+				   row; NULL if blank (see cell). */
+  int chunk_cols;		/* Chunks per row of the world. */
+
+  change_t *history;		/* Circular buffer of REWIND_CHANGES changes. */
+  size_t history_first, history_last; /* Oldest and next change (unwrapped). */
+
+  claim_t claim[CLAIM_SLOTS];	/* Cells claimed by heads (see advance). */
+  claim_t vacated[CLAIM_SLOTS];	/* Cells left by tails. */
+  unsigned int step;		/* Steps taken, to tell the slots in use. */
+
+  uint64_t movie_origin;	/* When the first frame of the intro is due. */
+  int movie_shown;		/* Intro frame shown; -1 if none. */
+
+  uint64_t deadline;		/* When the next game step is due. */
+  int steps;			/* Game steps since the last frame drawn. */
+  uint64_t bytes;		/* Output written before the frame drawn. */
+  uint64_t blocked;		/* Time the terminal kept output waiting so far. */
+
+  scene_t *scenes;		/* The game scenes, if hosted. */
+} game_t;
+
+game_t solo;			/* The game, unless hosting. */
+
+attr_t cell_attr[256];	/* Attributes to draw each board char with. */
+attr_t border_attr;	/* Attributes to draw the borders with. */
+
+unsigned char board_pixel[256];	/* Pixel kind of each char of the board. */
+cchar_t half_block[N_PIXELS][N_PIXELS]; /* Glyph of each upper, lower pixels. */
+char edge_row[SCENE_COLS];	/* Rows of the borders, in pixels (EDGE). */
+char blank_row[SCENE_COLS];	/* A row below the last one, in pixels. */
+
+scene_t *stock_scene;		/* The game scenes, as read. */
+scene_t *intro_frames;		/* The whole intro, if read at once (by a host). */
+int intro_nscenes;		/* Frames of the intro, if read at once. */
+
+/* End the game, as SIGINT does. The variable go_on controls the main
+   loop. */
+
+void quit (game_t *game)
+{
+  game->go_on=0;
+}
+
+/* End the game, as SIGHUP and SIGTERM do. Unlike SIGINT, these end the
+   intro and the game alike, so that the program exits cleanly (see
+   stats_open). */
+
+void hang_up (game_t *game)
+{
+  game->go_on=0;
+  game->hung_up=1;
+}
+
+/* Resize the game, as SIGWINCH does. The layout is recomputed by the
+   main loop. */
+
+void on_resize (game_t *game)
+{
+  game->resized=1;
+}
+
+/* Tell the game what its terminal signaled. */
+
+void game_signal (game_t *game, int signum)
+{
+  switch (signum)
+    {
+    case SIGWINCH:
+      on_resize (game);
+      break;
+    case SIGINT:
+      quit (game);
+      break;
+    default:
+      hang_up (game);
+      break;
+    }
+}
 
-/* Energy blocks. */
+/* Handler of the signals to the game, unless hosting. */
 
-struct
+void on_signal (int signum)
 {
-  int x;			/* Coordinate x of the energy block. */
-  int y;			/* Coordinate y of the energy block. */
-} energy_block[MAX_ENERGY_BLOCKS_LIMIT]; /* Array of energy blocks. */
+  game_signal (&solo, signum);
+}
 
 /* Load all scenes from dir into the scene vector.
 
    The scene vector is an array of nscenes matrixes of
-   NROWS x NCOLS chars, containg the ascii image.
+   SCENE_ROWS x SCENE_COLS chars, containg the ascii image. Only the
+   top-left NROWS x NCOLS corner is shown, framed by the board borders,
+   so that the view may change with the terminal size without reading
+   the scenes again.
 
 */
 
-/* All chars of one single scene. */
-
-typedef char scene_t[40][90]; /* Maximum values. TODO: allocate dyamically */
-
 /* Count how many scene files exist in the given directory and returns this number one.
    Complexity: O(log(n)) */
 
@@ -200,6 +481,58 @@ int countfiles(char* dir, char* data_dir)
   #undef SFOPEN
 }
 
+/* Read the k-th scene (from zero) in the 'dir' directory into scene.
+   Return 0 on success, or -1 if it can't be read. */
+
+int readscene (char *dir, char *data_dir, int k, scene_t scene)
+{
+  int i, j;
+  FILE *file;
+  char scenefile[1024], c = 0;
+
+  /* Program always read scenes from the installed data path (DATADIR, e.g.
+     /usr/share/<dir>. Therefore, if scenes are modified, they should be
+     reinstalle (program won't read them from project tree.)  */
+  sprintf (scenefile, "%s/%s/scene-%07d.txt",data_dir, dir, k+1);
+
+  /* Dont know if the line was for debug or not, commenting it
+  printf ("Reading from %s\n", scenefile); */
+
+  file = fopen (scenefile, "r");
+  if (!file)
+    return -1;
+
+  /* Read SCENE_ROWS rows of SCENE_COLS columns. Borders are not stored;
+     they are drawn around the current view by draw(). */
+
+  for (i=0; i<SCENE_ROWS; i++)
+    {
+      for (j=0; j<SCENE_COLS; j++)
+	{
+
+	  /* Actual ascii text file may be smaller than SCENE_ROWS x SCENE_COLS.
+	     If we read something out of the 32-127 ascii range,
+	     consider a blank instead. Short lines and files are padded. */
+
+	  c = (char) fgetc (file);
+	  if ((c == '\n') || (c == EOF))
+	    break;
+	  scene[i][j] = ((c>=' ') && (c<='~')) ? c : BLANK;
+	}
+
+      for (; j<SCENE_COLS; j++)
+	scene[i][j] = BLANK;
+
+      /* Discard the rest of the line (if longer than SCENE_COLS). */
+
+      while ((c != '\n') && (c != EOF))
+	c = fgetc (file);
+    }
+
+  fclose (file);
+  return 0;
+}
+
 /* Read all the scenes in the 'dir' directory, save it in 'scene' and
    return the number of readed scenes. If zero is passed as nscenes,
    then calculate the actual number and allocate appropriate space in
@@ -207,9 +540,9 @@ int countfiles(char* dir, char* data_dir)
 
 int readscenes (char *dir, char *data_dir, scene_t** scene, int nscenes)
 {
-  int i, j, k;
-  FILE *file;
-  char scenefile[1024], c, allocate = false;
+  int k;
+  char allocate = false;
+  uint64_t start = monotonic_usec();
 
   if (nscenes == 0)
   {
@@ -226,564 +559,2030 @@ int readscenes (char *dir, char *data_dir, scene_t** scene, int nscenes)
   /* Read nscenes. */
 
   for (k=0; k<nscenes; k++)
-  {
-
-    /* Program always read scenes from the installed data path (DATADIR, e.g.
-       /usr/share/<dir>. Therefore, if scenes are modified, they should be
-       reinstalle (program won't read them from project tree.)  */
-    sprintf (scenefile, "%s/%s/scene-%07d.txt",data_dir, dir, k+1);
-
-    /* Dont know if the line was for debug or not, commenting it
-    printf ("Reading from %s\n", scenefile); */
-    
-    file = fopen (scenefile, "r");
-    if (!file)
-    {
-      if (allocate)
-        free(*scene);
-      endwin();
-      sysfatal (!file);
-    }
-
-    /* Write up and down borders and correct stream position of
-       up border.*/
+    if (readscene (dir, data_dir, k, (*scene)[k]) < 0)
+      {
+	if (allocate)
+	  free(*scene);
+	endwin();
+	sysfatal (1);
+      }
 
-    for (j=0; j<NCOLS; j++)
-    {
-      (*scene)[k][0][j] = '-';
-      (*scene)[k][NROWS-1][j] = '-';
-    }
+  trace_span ("readscenes", start);
+  return k;
+}
 
-    fseek(file, sizeof(char) * NCOLS, SEEK_CUR);
-    while (((c = fgetc(file)) != '\n') && (c != EOF));
 
-    /* Iterate through NROWS. */
+/* Set up the colors of the board cells, if the terminal has them. Only
+   the snakes, the energy blocks and the borders are colored; blanks keep
+   the terminal's default colors. */
 
-    for (i=1; i<NROWS-1; i++)
-  	{
+void init_colors (void)
+{
+  if (monochrome || !has_colors())
+    return;
+
+  start_color();
+  use_default_colors();
+
+  init_pair(PAIR_SNAKE, COLOR_GREEN, -1);
+  init_pair(PAIR_RIVAL, COLOR_MAGENTA, -1);
+  init_pair(PAIR_BLOCK, COLOR_YELLOW, -1);
+  init_pair(PAIR_BORDER, COLOR_CYAN, -1);
+
+  cell_attr[(unsigned char) SNAKE_HEAD] = COLOR_PAIR(PAIR_SNAKE) | A_BOLD;
+  cell_attr[(unsigned char) SNAKE_BODY] = COLOR_PAIR(PAIR_SNAKE);
+  cell_attr[(unsigned char) SNAKE_TAIL] = COLOR_PAIR(PAIR_SNAKE);
+  cell_attr[(unsigned char) RIVAL_HEAD] = COLOR_PAIR(PAIR_RIVAL) | A_BOLD;
+  cell_attr[(unsigned char) RIVAL_BODY] = COLOR_PAIR(PAIR_RIVAL);
+  cell_attr[(unsigned char) ENERGY_BLOCK] = COLOR_PAIR(PAIR_BLOCK) | A_BOLD;
+  border_attr = COLOR_PAIR(PAIR_BORDER);
+}
 
-      /* Write left border and correct stream position */
+/* Set up the pixel kind of each board char, and the pixel rows drawn
+   above and below the board (hires mode). These are the same for every
+   game. */
 
-      (*scene)[k][i][0] = '|';
-      fseek(file, sizeof(char), SEEK_CUR);
+void init_pixels (void)
+{
+  memset (board_pixel, PX_ART, sizeof (board_pixel));
+  board_pixel[(unsigned char) BLANK] = PX_BLANK;
+  board_pixel[(unsigned char) EDGE] = PX_BORDER;
+  board_pixel[(unsigned char) SNAKE_HEAD] = PX_HEAD;
+  board_pixel[(unsigned char) SNAKE_BODY] = PX_SNAKE;
+  board_pixel[(unsigned char) SNAKE_TAIL] = PX_SNAKE;
+  board_pixel[(unsigned char) RIVAL_HEAD] = PX_RIVAL_HEAD;
+  board_pixel[(unsigned char) RIVAL_BODY] = PX_RIVAL;
+  board_pixel[(unsigned char) ENERGY_BLOCK] = PX_BLOCK;
+
+  memset (edge_row, EDGE, SCENE_COLS);
+  memset (blank_row, BLANK, SCENE_COLS);
+}
 
-      /* Read NCOLS columns from row i.*/
+/* Set up the glyphs of the hires mode. Each terminal cell shows two
+   pixels, the upper and the lower half, and the glyph and color pair of
+   every pair of pixel kinds is worked out here once, so that drawing a
+   cell is just two table lookups. Where both halves are lit with different
+   colors, the upper one is the foreground and the lower one the background
+   of an upper half block. Without colors, all lit pixels look the same. */
 
-  	  for (j=1; j<NCOLS-1; j++)
+void init_halfblocks (void)
+{
+  static const short pixel_color[N_PIXELS] =
+    {-1, COLOR_WHITE, COLOR_GREEN, COLOR_WHITE, COLOR_MAGENTA, COLOR_RED,
+     COLOR_YELLOW, COLOR_CYAN};
+  wchar_t glyph[2] = {0, 0};
+  int top, bottom, colors;
+  short fg, bg, pair;
+
+  colors = !monochrome && has_colors()
+    && (COLOR_PAIRS >= PAIR_HALF + N_PIXELS * N_PIXELS);
+
+  for (top=0; top<N_PIXELS; top++)
+    for (bottom=0; bottom<N_PIXELS; bottom++)
       {
-
-        /* Actual ascii text file may be smaller than NROWS x NCOLS.
-           If we read something out of the 32-127 ascii range,
-           consider a blank instead.*/
-
-        c = (char) fgetc (file);
-        (*scene)[k][i][j] = ((c>=' ') && (c<='~')) ? c : BLANK;
+	fg = pixel_color[top];
+	bg = -1;
+	pair = 0;
+
+	if ((top == PX_BLANK) && (bottom == PX_BLANK))
+	  glyph[0] = L' ';
+	else if (top == PX_BLANK)
+	  {
+	    glyph[0] = LOWER_HALF;
+	    fg = pixel_color[bottom];
+	  }
+	else if (bottom == PX_BLANK)
+	  glyph[0] = UPPER_HALF;
+	else if ((top == bottom) || !colors)
+	  glyph[0] = FULL_BLOCK;
+	else
+	  {
+	    glyph[0] = UPPER_HALF;
+	    bg = pixel_color[bottom];
+	  }
+
+	if (colors && (glyph[0] != L' '))
+	  {
+	    pair = PAIR_HALF + top * N_PIXELS + bottom;
+	    init_pair(pair, fg, bg);
+	  }
+	setcchar(&half_block[top][bottom], glyph, A_NORMAL, pair, NULL);
       }
+}
 
-      /* Write right border and correct stream position */
-
-      (*scene)[k][i][NCOLS-1] = '|';
-      fseek(file, sizeof(char), SEEK_CUR);
+/* Draw the given scene as pixels, two rows per terminal line (hires mode).
+   The pixel kind of each char is looked up in the given table; the top and
+   bottom borders are rows of EDGE chars, so the inner loop needs no tests.
+   Only the given sides are drawn as borders. Each line is composed in full
+   and output with a single call. */
 
+void draw_pixels (game_t *game, scene_t* scene, int number,
+		  const unsigned char *pixel, int borders)
+{
+  cchar_t line[SCENE_COLS];
+  const char *upper, *lower;
+  int i, j;
 
-      /* Discard the rest of the line (if longer than NCOLS). */
+  for (i=0; i<game->NROWS; i+=2)
+    {
+      upper = (((i == 0) && (borders & BORDER_TOP))
+	       || ((i == game->NROWS-1) && (borders & BORDER_BOTTOM)))
+	? edge_row : scene[number][i];
+      lower = ((i+1 == game->NROWS-1) && (borders & BORDER_BOTTOM)) ? edge_row
+	: (i+1 == game->NROWS) ? blank_row : scene[number][i+1];
+
+      for (j=0; j<game->NCOLS; j++)
+	line[j] = half_block[pixel[(unsigned char) upper[j]]][pixel[(unsigned char) lower[j]]];
+      if (borders & BORDER_LEFT)
+	line[0] = half_block[PX_BORDER][(i+1 < game->NROWS) ? PX_BORDER : PX_BLANK];
+      if (borders & BORDER_RIGHT)
+	line[game->NCOLS-1] =
+	  half_block[PX_BORDER][(i+1 < game->NROWS) ? PX_BORDER : PX_BLANK];
+
+      grid_move (&game->grid, i/2, 0);
+      grid_add_wchnstr (&game->grid, line, game->NCOLS);
+    }
+}
 
-  	  while (((c = fgetc(file)) != '\n') && (c != EOF));
+/* Where the text of a scene taller than the board lines starts to be shown
+   (hires mode). The rows holding any text are centered on the lines. */
 
-  	}
+int text_offset (game_t *game, scene_t* scene, int number, int lines)
+{
+  int i, j, first = -1, last = 0, offset;
 
-  fclose (file);
+  for (i=1; i<game->NROWS-1; i++)
+    for (j=1; j<game->NCOLS-1; j++)
+      if (scene[number][i][j] != BLANK)
+	{
+	  if (first < 0)
+	    first = i;
+	  last = i;
+	  break;
+	}
 
-  }
+  if (first < 0)
+    return 0;
 
-  return k;
+  offset = (first + last + 1) / 2 - lines / 2;
+  return (int) fmax(0, fmin(offset, game->NROWS - lines));
 }
 
+/* Send a hosted game's terminal what changed on its grid since the last
+   frame sent. The rows written to are compared with those sent, and only
+   the cells which differ are encoded, as a recording's are (see
+   record_frame), into the terminal's queue. */
 
-/* Draw a the given scene on the screen. Currently, this iterates through the
-   scene matrix outputig each caracter by means of indivudal puchar calls. One
-   may want to try a different approach which favour performance. For instance,
-   issuing a single 'write' call for each line. Would this yield any significant
-   performance improvement? */
-
-void draw (scene_t* scene, int number)
+void send_frame (game_t *game)
 {
-  int i, j;
+  grid_t *grid = &game->grid;
+  sent_t *sent = &game->sent;
+  cchar_t *row, *was;
+  char cell[ANSI_CELL_MAX];
+  int y, x, n;
 
-  wmove(main_window, 0, 0);
-  for (i=0; i<NROWS; i++)
+  if (sent->fresh)
     {
-      for (j=0; j<NCOLS; j++)
+      fputs (ANSI_CLEAR, game->term->out);
+      for (x = 0; x < grid->rows * grid->cols; x++)
+	setcchar (&sent->cells[x], L" ", A_NORMAL, 0, NULL);
+      memset (grid->dirty, 1, grid->rows);
+      sent->cursor_y = sent->cursor_x = -1;
+      sent->pen_attrs = A_NORMAL;
+      sent->pen_pair = 0;
+      sent->fresh = 0;
+    }
+
+  for (y = 0; y < grid->rows; y++)
+    {
+      if (!grid->dirty[y])
+	continue;
+
+      row = GRID_ROW (grid, y);
+      was = sent->cells + y * grid->cols;
+      for (x = 0; x < grid->cols; x++)
 	{
-	  waddch(main_window, scene[number][i][j]);
+	  if (!memcmp (&row[x], &was[x], sizeof (*row)))
+	    continue;
+
+	  n = 0;
+	  if (y != sent->cursor_y || x != sent->cursor_x)
+	    n += ansi_move (cell, sent->top + y, sent->left + x);
+	  n += ansi_cell (cell + n, &row[x], &sent->pen_attrs, &sent->pen_pair);
+	  fwrite (cell, 1, n, game->term->out);
+
+	  sent->cursor_y = y;
+	  sent->cursor_x = x + 1 < grid->cols ? x + 1 : -1; /* Maybe past the margin. */
+	  was[x] = row[x];
 	}
     }
-  wrefresh(main_window);
 }
 
-#define BLOCK_INACTIVE -1
+/* Show what the game drew, the rows written to since the last frame: a
+   hosted game sends them to its terminal, and otherwise ncurses is handed
+   them, and sends the terminal the cells which changed. */
 
-/* Draw scene indexed by number, get some statics and repeat.
-   If meny is true, draw the game controls.*/
-void showscene (scene_t* scene, int number, int menu)
+void show_frame (game_t *game)
 {
-  double fps;
-  int i;
+  grid_t *grid = &game->grid;
+  int y;
 
-  /* Draw the scene. */
+  if (game->term)
+    send_frame (game);
+  else
+    {
+      for (y = 0; y < grid->rows; y++)
+	if (grid->dirty[y])
+	  mvwadd_wchnstr (game->main_window, y, 0, GRID_ROW (grid, y), grid->cols);
+      wrefresh (game->main_window);
+    }
+
+  memset (grid->dirty, 0, grid->rows);
+}
+
+/* Draw a the given scene on the screen. Currently, this iterates through the
+   scene matrix outputig each caracter by means of indivudal puchar calls. One
+   may want to try a different approach which favour performance. For instance,
+   issuing a single 'write' call for each line. Would this yield any significant
+   performance improvement?
 
-  draw (scene, number);
+   Only the NROWS x NCOLS view is drawn; its outermost rows and columns are
+   replaced by the board borders, except, in a large world, where the view
+   doesn't reach the world's edge (see render_view). If look is LOOK_BOARD,
+   the scene is the game board and its cells are colored by what they hold.
+   Each row is output in runs of cells sharing the same attributes, one call
+   per run, so that the attributes change (and the terminal gets an escape
+   sequence) only where a run ends.
 
-  memcpy (&before, &now, sizeof (struct timeval));
-  gettimeofday (&now, NULL);
+   In hires mode, the board is drawn as half blocks by draw_pixels(), and
+   the text is shown at one row per line, as much of it as fits. So is the
+   intro, whose shaded art would be lost in pixels of a single kind.
 
-  if(!player_lost && !pause_game) {
-    timeval_subtract (&elapsed_last, &now, &before);
+   The scene is drawn on the game's grid. Every cell of the board lines is
+   written, so the grid is never cleared between frames: the terminal is
+   only sent the cells which differ from what it shows (see show_frame). */
 
-    /* elapsed_total = now - beginning + time before game is paused */
-    timeval_subtract (&elapsed_total, &now, &beginning);
-    timeval_add(&elapsed_total, &elapsed_total, &elapsed_pause);
-  }
+void draw (game_t *game, scene_t* scene, int number, int look)
+{
+  int i, j, k, lines, offset = 0, borders, last;
+  char *row;
+  attr_t attr;
+  uint64_t start;
 
-  if(number == 0){
-    for (i=0; i<max_energy_blocks; i++)
-      if(energy_block[i].x != BLOCK_INACTIVE)
-        scene[number][energy_block[i].y][energy_block[i].x] = ENERGY_BLOCK;
-  }
+  start = monotonic_usec();
 
-  fps = 1 / (elapsed_last.tv_sec + (elapsed_last.tv_usec * 1E-6));
-  
+  lines = BOARD_LINES;
+  borders = (look == LOOK_BOARD) ? game->view_borders : BORDER_ALL;
+  last = (borders & BORDER_RIGHT) ? game->NCOLS-1 : game->NCOLS;
 
-  if (menu)
+  if (hires && (look == LOOK_BOARD))
     {
-      wprintw (main_window, "Elapsed: %5ds, fps=%5.2f\n", /* CR-LF because of ncurses. */
-	      (int) elapsed_total.tv_sec, fps);
-      /*Add to the menu score and blocks collected */	  
-      wprintw (main_window, "Score: %.d\n", block_count);
-      wprintw (main_window, "Energy: %d\n", snake.energy); 
-      for(i = 0; i < snake.energy; i++){
-	    if(i % ((MAX_SNAKE_ENERGY/100)*5) == 0){ /*prints one bar for every 5% energy left*/
-	   	 wprintw(main_window, "|");
-	    }	 
-      }
-      wprintw(main_window, "\n");
-      wprintw (main_window, "Controls: q: quit | r: restart | WASD: move the snake | +/-: change game speed\n");
-      wprintw (main_window, "          h: help & settings | p: pause game\n");
+      draw_pixels (game, scene, number, board_pixel, borders);
+      goto done;
     }
-}
-
-/* This function is called whenever a block becomes inactive. It goes through the array of
- * energy blocks until it finds the inactive block. It then replaces it, and ends.*/
-void more_snacks(){
-   /* Generate energy blocks away from the borders and the snake */
- 	int i = 0, j, isValid = 0;
 
-	/* Check the array of energy blocks, one by one. If current block is inactive, generate a new
-	 * (x,y) ordered pair of coordinates and make it active again. Check if the new position
-	 * is a valid position(i.e., it's not a position that the snake currently occupies). If
-	 * the new position is not valid, generate a new (x,y) ordered pair and check again. 
-	 * Once an invalid block is replaced, break from the loop.*/ 
-
-	do{
-		if(energy_block[i].x == BLOCK_INACTIVE){
-			do{
-				isValid = 1;
-				energy_block[i].x = (rand() % (NCOLS - 2)) + 1;
-  	  			energy_block[i].y = (rand() % (NROWS - 2)) + 1;
-				for(j = 0; j < snake.length; j++){
-					if(energy_block[i].x == snake.positions[j].x){
-						if(energy_block[i].y== snake.positions[j].y){
-							isValid = 0;
-							/*isValid is being used both as a check to see if
-							the new position is valid, and to see if the inactive block
-							that prompted the funtion call has already been replaced.*/
-							break;
-						}
-					}
-				}
-			}while(isValid != 1);
-		}
-		i++;
-	}while(i < max_energy_blocks && isValid == 0);						
-	
-	return;
-}
+  if (hires)
+    offset = text_offset (game, scene, number, lines);
 
+  for (i=0; i<lines; i++)
+    {
+      grid_move(&game->grid, i, 0);
+      grid_attrset(&game->grid, border_attr);
 
-  /* Instantiate the snake and a set of energy blocks. */
+      if (((i == 0) && (borders & BORDER_TOP))
+	  || ((i == lines-1) && (borders & BORDER_BOTTOM)))
+	{
+	  grid_hline(&game->grid, '-', game->NCOLS);
+	  continue;
+	}
 
-/* Put above the showscene function so I could use it to display active blocks on current scene */
-/* #define BLOCK_INACTIVE -1 */
+      if (borders & BORDER_LEFT)
+	grid_addch(&game->grid, '|');
 
-void init_game (scene_t* scene)
-{
-  int i;
-	
-  srand(time(NULL));
-  /*Set initial score and blocks collected 0 */
-  block_count = 0;
-  snake.energy = (NCOLS + NROWS);
-  snake.head.x = 0;
-  snake.head.y = 0;
-  snake.direction = right;
-  snake.lastdirection = snake.direction;
-  snake.length = 7;
+      row = scene[number][i + offset];
+      for (j = (borders & BORDER_LEFT) ? 1 : 0; j<last; j=k)
+	{
+	  attr = (look == LOOK_BOARD) ? cell_attr[(unsigned char) row[j]] : A_NORMAL;
+	  for (k=j+1; k<last; k++)
+	    if (((look == LOOK_BOARD) ? cell_attr[(unsigned char) row[k]] : A_NORMAL) != attr)
+	      break;
 
-	const pair_t initialPosition[] = {
-		{10, 8},
-		{11, 8},
-		{12, 8},
-		{13, 8},
-		{14, 8},
-		{14, 9},
-		{14, 10}
-	};
+	  grid_attrset(&game->grid, attr);
+	  grid_addnstr(&game->grid, row + j, k - j);
+	}
 
-  /* Initialize position of the snake, from tail to head. */
-	snake.positions = (pair_t *) malloc(snake.length * sizeof(pair_t));
-	for(i = 0; i < snake.length; i++){
-		snake.positions[i].x = initialPosition[i].x;
-		snake.positions[i].y = initialPosition[i].y;
+      if (borders & BORDER_RIGHT)
+	{
+	  grid_attrset(&game->grid, border_attr);
+	  grid_addch(&game->grid, '|');
+	}
+    }
+  grid_attrset(&game->grid, A_NORMAL);
 
-		scene[0][initialPosition[i].y][initialPosition[i].x] = SNAKE_BODY;
+ done:
+  show_frame (game);
 
-	}
-   /* Generate energy blocks away from the borders */
-  for (i=0; i<max_energy_blocks; i++)
-  {
-    energy_block[i].x = (rand() % (NCOLS - 2)) + 1 ;
-    energy_block[i].y = (rand() % (NROWS - 2)) + 1;
-  }
+  STAT_ADD (frames, 1);
+  STAT_ADD (render_usec, monotonic_usec() - start);
+  trace_span ("draw", start);
 
-  /* Set to zero elapsed_total when the player pressed pause */
-  elapsed_pause.tv_sec = 0;
-  elapsed_pause.tv_usec = 0;
-}
-
-/* This function increases the snake's size by one.
-   It adds the new piece of the snake's body to the
-   first position of the vector, i.e., the new piece
-   becomes the snake's tail. However, since this function
-   is called after the snake has moved, the tail isn't 
-   erased from the screen, and the visual effect 
-   should be as if the new piece was added to the 
-   middle of the body, even though technically the new 
-   piece is added to the end of the body.
- */
-
-void snake_snack(int tail_x, int tail_y)
-{	
-	pair_t *auxVector;
-	int i, auxCounter;
-
-	auxCounter = snake.length; /*Save the current length of the snake*/
-	snake.length++;/*Increase the length of the snake*/
-
-	auxVector = (pair_t *) malloc(auxCounter * sizeof(pair_t));/*allocate enough space*/
-	memmove(auxVector, snake.positions, auxCounter * sizeof(pair_t));/*save all snake positions*/
-
-	snake.positions =(pair_t*)realloc(snake.positions, sizeof(pair_t) * snake.length);/*Increase the size of the positions vector*/
-	snake.positions[0].y = tail_y;/*Add the new piece to the snake's body*/
-	snake.positions[0].x = tail_x;
-	
-	for(i = 0; i <  auxCounter; i++){/*Repopulate the snake.positions vector*/
-		snake.positions[i + 1].x = auxVector[i].x;
-		snake.positions[i + 1].y = auxVector[i].y;
-	}
+  record_frame ();
+}
 
-	free(auxVector);
-	return;
-}	
+#define BLOCK_INACTIVE -1
 
+/* The lower panel, below the board.
 
-/* This function advances the game. It computes the next state
-   and updates the scene vector. This is Tron's game logic. */
-
-void advance (scene_t* scene)
-{
-	pair_t head, tail, last1_tail, last2_tail, body;
-	/* Setting the body position. */
-	body = snake.positions[snake.length - 1];
-	/* Setting the head position. */
-	head = snake.positions[snake.length - 1];
-	/* Setting the tail position. */
-	last1_tail = snake.positions[1];
-	last2_tail = snake.positions[2];
-	tail = snake.positions[0];
-
-	int i, flag = 0;
-
-	/* Calculate next position of the head. */
-	switch(snake.direction){
-		case up:
-			head.y -= 1;
-			break;
-		case right:
-			head.x += 1;
-			break;
-		case left:
-			head.x -= 1;
-			break;
-		case down:
-			head.y += 1;
-			break;
-	}
+   The panel is retained: its labels and the controls are drawn once,
+   when it's first shown or the board changed size (see layout). After
+   that, each number is formatted (with integer arithmetic) only when its
+   value changed, and written over the old one, and the energy bar grows
+   or shrinks by the cells which changed. Nothing changed, nothing is
+   written to the grid. */
 
-	/* Lose energy at every step */
-	if(player_lost == 0)
-    	snake.energy--;
+const field_t panel_fields[N_FIELDS] =
+  {{0, 9, 5, 0, 1, 0, -1},	/* As "%5d". */
+   {0, 21, 5, 2, 3, 0, -1},	/* As "%5.2f". */
+   {1, 7, 0, 0, 0, 0, -1},	/* As "%.d" (nothing for zero). */
+   {2, 8, 0, 0, 1, 0, -1}};	/* As "%d". */
 
-	snake.lastdirection = snake.direction;
+const char *panel_text[LOWER_PANEL_ROWS] =
+  {"Elapsed:      s, fps=",
+   "Score: ",
+   "Energy: ",
+   "",
+   "Controls: q: quit | r: restart | WASD: move the snake | +/-: change game speed",
+   "          h: help & settings | p: pause game | z (hold): rewind"};
 
-	/*When the head position is the same as the energy block*/
-	for(i = 0; i < max_energy_blocks; i++)
-	{
-		if(head.x == energy_block[i].x && head.y == energy_block[i].y)
-		{
-			block_count += 1;
-			flag = 1;
-			energy_block[i].x = BLOCK_INACTIVE;
-			snake.energy += (NCOLS + NROWS) / 2 * (sqrt(2) / sqrt(max_energy_blocks + 1));
-			if(snake.energy > MAX_SNAKE_ENERGY){
-				snake.energy = MAX_SNAKE_ENERGY;
-			}
-			more_snacks();
-		}
-	}
-	
+/* Show value in a field of the panel, if it isn't shown already. */
 
-  /* Check if head collided with border or itself or your energy is empty*/
-  if(   head.x <= 0 || head.x >= NCOLS - 1
-     || head.y <= 0 || head.y >= NROWS - 1
-     || scene[0][head.y][head.x] == SNAKE_BODY
-     || snake.energy <= 0)
-  {
-      player_lost = 1;
-      return;
-  }
+void panel_number (game_t *game, field_t *f, long value)
+{
+  char text[32], *end = text + sizeof (text), *p = end;
+  unsigned long v = value < 0 ? - (unsigned long) value : (unsigned long) value;
+  int digits, length, pad;
 
-	/* Advance snake in one step */
-	memmove(snake.positions, snake.positions + 1, sizeof(pair_t) * (snake.length-1));
-	snake.positions[snake.length - 1] = head;
-
-	/* Erase old position of the tail or add new piece to the snake */
-	if(flag == 0)
-	{	
-		scene[0][tail.y][tail.x] = ' ';
-	}else{
-		flag = 0;
-		snake_snack(tail.x, tail.y);
-	}
+  if (f->length >= 0 && value == f->value)
+    return;
 
-	/* Draw new two position of the tail */
-	scene[0][last1_tail.y][last1_tail.x] = SNAKE_TAIL;
-	scene[0][last2_tail.y][last2_tail.x] = SNAKE_TAIL;
-	/* Draw new position of the body */
-	scene[0][body.y][body.x] = SNAKE_BODY;
-	/* Draw new position of the head */
-	scene[0][head.y][head.x] = SNAKE_HEAD;
+  for (digits = 0; v > 0 || digits < f->precision; digits++)
+    {
+      if (f->decimals && digits == f->decimals)
+	*--p = '.';
+      *--p = '0' + v % 10;
+      v /= 10;
+    }
+  if (value < 0)
+    *--p = '-';
+  length = end - p;
+
+  /* Pad to the width, and blank what's left of a longer number. */
+
+  grid_move (&game->grid, game->panel_top + f->row, f->col);
+  pad = length < f->width ? f->width - length : 0;
+  if (pad)
+    grid_hline (&game->grid, ' ', pad);
+  grid_move (&game->grid, game->panel_top + f->row, f->col + pad);
+  grid_addnstr (&game->grid, p, length);
+  if (f->length > pad + length)
+    grid_hline (&game->grid, ' ', f->length - pad - length);
+
+  f->value = value;
+  f->length = pad + length;
 }
 
-/* This function plays the game introduction animation. */
+/* Bring the panel up to date. */
 
-void playmovie (scene_t* scene, int nscenes)
+void panel (game_t *game, double fps)
 {
+  int i, bars;
 
-  int k;
-  struct timespec how_long;
-  how_long.tv_sec = 0;
+  grid_attrset (&game->grid, A_NORMAL);
 
-  for (k=0; (k < nscenes) && (go_on); k++)
+  if (game->panel_top != BOARD_LINES)
     {
-      wclear (main_window);			               /* Clear screen.    */
-      wrefresh (main_window);			       /* Refresh screen.  */
-      showscene (scene, k, 0);                 /* Show k-th scene .*/
-      how_long.tv_nsec = (movie_delay) * 1e3;  /* Compute delay. */
-      nanosleep (&how_long, NULL);	       /* Apply delay. */
+      game->panel_top = BOARD_LINES;
+      for (i = 0; i < LOWER_PANEL_ROWS; i++)
+	{
+	  grid_move (&game->grid, game->panel_top + i, 0);
+	  grid_clrtoeol (&game->grid);
+	  grid_addnstr (&game->grid, panel_text[i], strlen (panel_text[i]));
+	}
+      for (i = 0; i < N_FIELDS; i++)
+	game->field[i].length = -1;
+      game->panel_bars = 0;
     }
-}
 
-void draw_settings(scene_t *scene){
-  char buffer[NCOLS];
-  int i;
+  panel_number (game, &game->field[FIELD_ELAPSED], game->elapsed_total.tv_sec);
+  panel_number (game, &game->field[FIELD_FPS], fps < 1E9 ? (long) (fps * 100 + 0.5) : 0);
+  panel_number (game, &game->field[FIELD_SCORE], game->block_count);
+  panel_number (game, &game->field[FIELD_ENERGY], game->snake->energy);
 
-  /* clean buffer */
-  for(i = 0; i < NCOLS; i++)
-    buffer[i] = ' ';
+  /* One bar for every 5% of the energy, or part of it. */
 
-  sprintf(buffer, "%.15s %c %3d %c     Maximum number of blocks to display at the same time.",
-          "", which_setting == 0 ? '<' : ' ', max_energy_blocks, which_setting == 0 ? '>' : ' ');
-  memcpy(&scene[2][22][12], buffer, strlen(buffer));
+  bars = game->snake->energy > 0 ? (game->snake->energy - 1) / ((MAX_SNAKE_ENERGY/100)*5) + 1 : 0;
+  if (bars > game->NCOLS)
+    bars = game->NCOLS;
+  if (bars > game->panel_bars)
+    {
+      grid_move (&game->grid, game->panel_top + 3, game->panel_bars);
+      grid_hline (&game->grid, '|', bars - game->panel_bars);
+    }
+  else if (bars < game->panel_bars)
+    {
+      grid_move (&game->grid, game->panel_top + 3, bars);
+      grid_hline (&game->grid, ' ', game->panel_bars - bars);
+    }
+  game->panel_bars = bars;
 }
 
+/* Take the panel off the grid. */
 
-/* This function implements the gameplay loop. */
+void panel_hide (game_t *game)
+{
+  if (game->panel_top < 0)
+    return;
+  grid_move (&game->grid, game->panel_top, 0);
+  grid_clrtobot (&game->grid);
+  game->panel_top = -1;
+}
 
-void playgame (scene_t* scene, char *data_dir)
+/* Draw scene indexed by number, get some statics and repeat.
+   If meny is true, draw the game controls.*/
+void showscene (game_t *game, scene_t* scene, int number, int menu)
 {
+  double fps;
+  uint64_t start;
 
-  struct timespec how_long;
-  how_long.tv_sec = 0;
+  /* Draw the scene. */
 
-  /* User may change delay (game speedy) asynchronously. */
+  draw (game, scene, number, (menu && (number == 0)) ? LOOK_BOARD : LOOK_TEXT);
 
-  while (go_on)
-    {
-      clear ();                               /* Clear screen. */
-      refresh ();			      /* Refresh screen. */
+  start = monotonic_usec();
 
-      if(!on_settings && !pause_game) {
-        advance (scene);		               /* Advance game.*/
-      } else if (on_settings) {
-        draw_settings(scene);
-      }
+  memcpy (&game->before, &game->now, sizeof (struct timeval));
+  gettimeofday (&game->now, NULL);
 
-      if(player_lost){
-        /* Write score on the scene */
-        char buffer[128];
-        sprintf(buffer, "%d", block_count);
-        memcpy(&scene[1][27][30], buffer, strlen(buffer));
-      }
+  if(!game->player_lost && !game->pause_game) {
+    timeval_subtract (&game->elapsed_last, &game->now, &game->before);
 
-      if(restart_game) {
-        /* Reset variables as at the beginning of the game */
-        go_on=1;
-        player_lost=0;
-        restart_game=0;
-        pause_game=0;
-        gettimeofday (&beginning, NULL);
+    /* elapsed_total = now - beginning + time before game is paused */
+    timeval_subtract (&game->elapsed_total, &game->now, &game->beginning);
+    timeval_add(&game->elapsed_total, &game->elapsed_total, &game->elapsed_pause);
+  }
 
-        init_game (scene);
-        readscenes (SCENE_DIR_GAME, data_dir, &scene, N_GAME_SCENES);
-      }
+  fps = 1 / (game->elapsed_last.tv_sec + (game->elapsed_last.tv_usec * 1E-6));
 
-      showscene (scene, /* Show k-th scene. */
-        player_lost ? 1 : on_settings ? 2 : pause_game ? 3 : 0,
-        on_settings ? 0 : 1);
+  if (menu)
+    panel (game, fps);
+  else
+    panel_hide (game);
 
-      how_long.tv_nsec = (game_delay) * 1e3;  /* Compute delay. */
-      nanosleep (&how_long, NULL);	      /* Apply delay. */
-    }
+  trace_span ("panel", start);
+}
+
+/* The playfield.
+
+   Normally, the playfield is the board itself, scene 0, and WROWS x WCOLS
+   is NROWS x NCOLS. In a large world, it may be as large as MAX_WORLD x
+   MAX_WORLD cells, and is kept apart: it is split in chunks of CHUNK x CHUNK
+   cells, which are only allocated (from world_arena) when something is
+   first written in them, so that memory grows with the area visited. The
+   board is then a view of the world (see camera and render_view), and game
+   logic must read and write the playfield through cell and cell_put. */
+
+/* Read a cell of the playfield. */
+
+char cell (game_t *game, scene_t* scene, int y, int x)
+{
+  char *c;
+
+  if (!world)
+    return scene[0][y][x];
+
+  c = game->chunk[(y >> CHUNK_BITS) * game->chunk_cols + (x >> CHUNK_BITS)];
+  return c ? c[(y & (CHUNK-1)) << CHUNK_BITS | (x & (CHUNK-1))] : BLANK;
+}
+
+/* Write a cell of the playfield, allocating its chunk if needed. */
+
+void cell_put (game_t *game, scene_t* scene, int y, int x, char c)
+{
+  char **slot;
+
+  if (!world)
+    {
+      scene[0][y][x] = c;
+      return;
+    }
+
+  slot = &game->chunk[(y >> CHUNK_BITS) * game->chunk_cols + (x >> CHUNK_BITS)];
+  if (!*slot)
+    {
+      *slot = arena_alloc (&game->world_arena, CHUNK * CHUNK);
+      sysfatal (!*slot);
+      memset (*slot, BLANK, CHUNK * CHUNK);
+    }
+  (*slot)[(y & (CHUNK-1)) << CHUNK_BITS | (x & (CHUNK-1))] = c;
+}
+
+/* Find the playfield cell shown at the board's top-left corner. In a large
+   world, the view follows the player's head, keeping it in the middle but
+   never showing beyond the world's edges. */
+
+void camera (game_t *game, int *y, int *x)
+{
+  *y = *x = 0;
+  if (!world)
+    return;
+
+  *y = (int) fmax(0, fmin(game->snake->head.y - game->NROWS / 2, game->WROWS - game->NROWS));
+  *x = (int) fmax(0, fmin(game->snake->head.x - game->NCOLS / 2, game->WCOLS - game->NCOLS));
+}
+
+/* Copy the part of a large world in view onto the board, a chunk row at a
+   time, so that it takes time proportional to the board, not the world. */
+
+void render_view (game_t *game, scene_t* scene)
+{
+  int i, x, y, cy, cx, n;
+  char *c;
+
+  camera (game, &cy, &cx);
+
+  /* Only the world's edges are drawn as borders. */
+
+  game->view_borders = (cy == 0 ? BORDER_TOP : 0)
+    | (cy + game->NROWS == game->WROWS ? BORDER_BOTTOM : 0)
+    | (cx == 0 ? BORDER_LEFT : 0)
+    | (cx + game->NCOLS == game->WCOLS ? BORDER_RIGHT : 0);
+  for (i=0; i<game->NROWS; i++)
+    {
+      y = cy + i;
+      for (x = cx; x < cx + game->NCOLS; x += n)
+	{
+	  n = (int) fmin(CHUNK - (x & (CHUNK-1)), cx + game->NCOLS - x);
+	  c = game->chunk[(y >> CHUNK_BITS) * game->chunk_cols + (x >> CHUNK_BITS)];
+	  if (c)
+	    memcpy (&scene[0][i][x - cx], &c[(y & (CHUNK-1)) << CHUNK_BITS | (x & (CHUNK-1))], n);
+	  else
+	    memset (&scene[0][i][x - cx], BLANK, n);
+	}
+    }
+}
+
+/* Game history, for rewinding.
+
+   Rather than snapshots of the game, the history keeps what each step
+   changed: the old contents of every board cell, snake piece, snake state
+   or energy block written, preceded by a CH_STEP record with the energy and
+   score as they were. Taking a step back undoes its changes in reverse
+   order, so both recording and rewinding cost time proportional to what
+   changed. Each change takes 12 bytes; the oldest steps are forgotten when
+   the history is full. Game logic must change the board and snakes through
+   the functions below for this to work. */
+
+/* Record a change in the history. */
+
+void remember (game_t *game, int what, int c, int who, int a, int b)
+{
+  change_t *ch;
+
+  if (!game->history)
+    return;
+
+  /* Forget the oldest step as a whole, to make room. */
+
+  if (game->history_last - game->history_first == REWIND_CHANGES)
+    do
+      game->history_first++;
+    while ((game->history_first != game->history_last)
+	   && (game->history[game->history_first % REWIND_CHANGES].what != CH_STEP));
+
+  ch = &game->history[game->history_last++ % REWIND_CHANGES];
+  ch->what = what;
+  ch->c = c;
+  ch->who = who;
+  ch->a = a;
+  ch->b = b;
+}
+
+/* Forget the whole history. */
+
+void forget (game_t *game)
+{
+  game->history_first = game->history_last = 0;
+}
+
+/* Write c on the game board. */
+
+void board_set (game_t *game, scene_t* scene, int y, int x, char c)
+{
+  if (cell (game, scene, y, x) == c)
+    return;
+  remember (game, CH_CELL, cell (game, scene, y, x), 0, y, x);
+  cell_put (game, scene, y, x, c);
+  if (controlled)
+    controller_cell (y, x, c);	/* Tell the controller, at the next step. */
+}
+
+/* Set the i-th piece of a snake (counting from the tail). */
+
+void piece_set (game_t *game, snake_t *s, int i, pair_t p)
+{
+  int slot = (s->tail + i) % s->capacity;
+
+  remember (game, CH_PIECE, 0, s - game->snakes, slot,
+	    s->positions[slot].x | s->positions[slot].y << 16);
+  s->positions[slot] = p;
+}
+
+/* Save the state of a snake, before it changes in a step. */
+
+void snake_save (game_t *game, snake_t *s)
+{
+  remember (game, CH_SNAKE, s->direction | s->lastdirection << 2 | s->alive << 4,
+	    s - game->snakes, s->tail, s->length);
+}
+
+/* Move an energy block. */
+
+void block_set (game_t *game, int k, int x, int y)
+{
+  remember (game, CH_BLOCK, 0, k, game->energy_block[k].x, game->energy_block[k].y);
+  game->energy_block[k].x = x;
+  game->energy_block[k].y = y;
+}
+
+/* Take back the last step recorded. Return 0 if there is none. */
+
+int rewind_step (game_t *game, scene_t* scene)
+{
+  change_t *ch;
+  snake_t *s;
+
+  if (game->history_last == game->history_first)
+    return 0;
+
+  do
+    {
+      ch = &game->history[--game->history_last % REWIND_CHANGES];
+      switch (ch->what)
+	{
+	case CH_STEP:
+	  game->snake->energy = ch->a;
+	  game->block_count = ch->b;
+	  break;
+	case CH_CELL:
+	  cell_put (game, scene, ch->a, ch->b, ch->c);
+	  break;
+	case CH_PIECE:
+	  game->snakes[ch->who].positions[ch->a].x = ch->b & 0xffff;
+	  game->snakes[ch->who].positions[ch->a].y = ch->b >> 16;
+	  break;
+	case CH_SNAKE:
+	  s = &game->snakes[ch->who];
+	  s->direction = ch->c & 3;
+	  s->lastdirection = (ch->c >> 2) & 3;
+	  s->alive = (ch->c >> 4) & 1;
+	  s->tail = ch->a;
+	  s->length = ch->b;
+	  s->head = PIECE(s, s->length - 1);
+	  break;
+	case CH_BLOCK:
+	  game->energy_block[ch->who].x = ch->a;
+	  game->energy_block[ch->who].y = ch->b;
+	  break;
+	}
+    }
+  while ((ch->what != CH_STEP) && (game->history_last != game->history_first));
+
+  return 1;
+}
+
+/* This function is called whenever a block becomes inactive. It goes through the array of
+ * energy blocks until it finds the inactive block. It then replaces it, and ends.*/
+void more_snacks(game_t *game, scene_t* scene){
+   /* Generate energy blocks away from the borders and the snakes */
+ 	int i, tries, x, y, cy, cx;
+	uint64_t start = monotonic_usec();
+
+	/* Check the array of energy blocks, one by one. If current block is inactive, generate a new
+	 * (x,y) ordered pair of coordinates and make it active again. The new position is valid
+	 * if it's blank on the board, i.e. it's not a position that some snake currently
+	 * occupies; this doesn't depend on how many or how long the snakes are. If the new
+	 * position is not valid, generate a new (x,y) ordered pair and check again, giving up
+	 * on a crowded board. Once an inactive block is replaced, stop. In a large world,
+	 * blocks are generated within the view. */ 
+
+	camera(game, &cy, &cx);
+
+	for(i = 0; i < game->max_energy_blocks; i++){
+		if(game->energy_block[i].x != BLOCK_INACTIVE)
+			continue;
+		for(tries = 0; tries < SNACK_TRIES; tries++){
+			x = cx + (rand() % (game->NCOLS - 2)) + 1;
+			y = cy + (rand() % (game->NROWS - 2)) + 1;
+			if(cell(game, scene, y, x) == BLANK){
+				block_set(game, i, x, y);
+				board_set(game, scene, y, x, ENERGY_BLOCK);
+				break;
+			}
+		}
+		break;
+	}
+	
+	trace_span ("more_snacks", start);
+	return;
+}
+
+/* Put the given snake on the board, tail to head, as drawn by advance(). */
+
+void lay_snake (game_t *game, scene_t* scene, snake_t *s)
+{
+  int i;
+  pair_t p;
+
+  for (i=0; i<s->length; i++)
+    {
+      p = PIECE(s, i);
+      board_set (game, scene, p.y, p.x,
+		 i < 2 ? SNAKE_TAIL : i < s->length-1 ? s->body_char : s->head_char);
+    }
+  s->head = PIECE(s, s->length-1);
+}
+
+/* Move to a random place an arena rival which has just been created or
+   which has crashed. The rival is laid straight on blank cells; if none
+   are found within the given number of tries, it stays off the board. In
+   a large world, rivals come back within the view. */
+
+void spawn_rival (game_t *game, scene_t* scene, snake_t *s, int tries)
+{
+  int i, x, y, dx, dy, cy, cx;
+  pair_t p;
+
+  camera (game, &cy, &cx);
+
+  s->alive = 0;
+  s->length = RIVAL_LENGTH;
+  s->tail = 0;
+
+  while (tries-- > 0)
+    {
+      s->direction = rand() % 4;
+      dx = s->direction == right ? 1 : s->direction == left ? -1 : 0;
+      dy = s->direction == down ? 1 : s->direction == up ? -1 : 0;
+
+      /* Tail position, leaving room for the body and a step ahead. */
+
+      x = cx + (rand() % (game->NCOLS - 2 - 2*RIVAL_LENGTH)) + 1 + (dx < 0 ? RIVAL_LENGTH + 1 : 0);
+      y = cy + (rand() % (game->NROWS - 2 - 2*RIVAL_LENGTH)) + 1 + (dy < 0 ? RIVAL_LENGTH + 1 : 0);
+
+      for (i=0; i <= RIVAL_LENGTH; i++)
+	if (cell (game, scene, y + i*dy, x + i*dx) != BLANK)
+	  break;
+      if (i <= RIVAL_LENGTH)
+	continue;
+
+      for (i=0; i<RIVAL_LENGTH; i++)
+	{
+	  p.x = x + i*dx;
+	  p.y = y + i*dy;
+	  piece_set (game, s, i, p);
+	}
+      s->lastdirection = s->direction;
+      s->alive = 1;
+      lay_snake (game, scene, s);
+      return;
+    }
+}
+
+/* Take the given snake off the board. */
+
+void clear_snake (game_t *game, scene_t* scene, snake_t *s)
+{
+  int i;
+
+  for (i=0; i<s->length; i++)
+    board_set (game, scene, PIECE(s, i).y, PIECE(s, i).x, BLANK);
+  s->alive = 0;
+}
+
+/* Set up a new game with the default settings, and the options. */
+
+void game_defaults (game_t *game)
+{
+  game->game_delay = 9E4;	  /* Game frame duration in usec (4usec) */
+  game->max_energy_blocks = 3;
+  game->frame_skip = 1;
+  game->view_borders = BORDER_ALL;
+  memcpy (game->field, panel_fields, sizeof (panel_fields));
+  game->panel_top = -1;
+  game->snake = &game->snakes[0];
+  game->WROWS = world_rows;
+  game->WCOLS = world_cols;
+}
+
+/* Take all the memory of a game at once (see init_game). Return -1 if
+   there's not enough. */
+
+int game_memory (game_t *game)
+{
+  if (!game->game_arena.base && (arena_init (&game->game_arena, GAME_MEMORY) < 0))
+    return -1;
+
+  if (world && !game->world_arena.base
+      && (arena_reserve (&game->world_arena, (size_t) CHUNKS(game->WROWS)
+			 * CHUNKS(game->WCOLS) * CHUNK * CHUNK) < 0))
+    return -1;
+
+  return 0;
+}
+
+  /* Instantiate the snakes and a set of energy blocks. */
+
+/* Put above the showscene function so I could use it to display active blocks on current scene */
+/* #define BLOCK_INACTIVE -1 */
+
+/* Put the player's snake, off the board, where a game starts. */
+
+void start_snake (game_t *game, snake_t *s)
+{
+  int i;
+  pair_t p;
+
+	const pair_t initialPosition[] = {
+		{10, 8},
+		{11, 8},
+		{12, 8},
+		{13, 8},
+		{14, 8},
+		{14, 9},
+		{14, 10}
+	};
+
+  s->direction = right;
+  s->lastdirection = s->direction;
+  s->length = 7;
+  s->tail = 0;
+
+  /* Initialize position of the snake, from tail to head. A large world is
+     entered at its middle. */
+	for(i = 0; i < s->length; i++){
+		p = initialPosition[i];
+		p.x += (game->WCOLS - game->NCOLS) / 2;
+		p.y += (game->WROWS - game->NROWS) / 2;
+		piece_set(game, s, i, p);
+	}
+}
+
+void init_game (game_t *game, scene_t* scene)
+{
+  int i;
+  pair_t *positions;		/* Room for all snakes' bodies. */
+	
+  srand(time(NULL));
+  /*Set initial score and blocks collected 0 */
+  game->block_count = 0;
+
+  /* The board file frames a TEXT_ROWS x SCENE_COLS board, where the
+     borders are drawn over it; on a taller (hires) board it would be left
+     inside, so it is cleared. */
+
+  for (i=0; i<SCENE_COLS; i++)
+    scene[0][0][i] = scene[0][TEXT_ROWS-1][i] = BLANK;
+  for (i=0; i<SCENE_ROWS; i++)
+    scene[0][i][0] = scene[0][i][SCENE_COLS-1] = BLANK;
+
+  /* All the memory of a game comes from game_arena, sized for the number
+     of snakes at the first game and reused by the next ones. Room for the
+     bodies is carved at once for all snakes; the player may grow as large
+     as the board, rivals up to MAX_RIVAL_LENGTH. */
+
+  sysfatal (game_memory (game) < 0);
+  arena_reset (&game->game_arena);
+
+  game->nsnakes = 1 + arena_rivals;
+  positions = (pair_t *) arena_alloc(&game->game_arena, (MAX_SNAKE_LENGTH + arena_rivals * MAX_RIVAL_LENGTH) * sizeof(pair_t));
+  game->history = (change_t *) arena_alloc(&game->game_arena, REWIND_CHANGES * sizeof(change_t));
+  sysfatal (!positions || !game->history);
+
+  /* A large world starts blank: the chunks of the last one are given back. */
+
+  if (world)
+    {
+      arena_reset (&game->world_arena);
+
+      game->chunk_cols = CHUNKS(game->WCOLS);
+      game->chunk = (char **) arena_alloc(&game->game_arena,
+					   CHUNKS(game->WROWS) * game->chunk_cols * sizeof(char *));
+      sysfatal (!game->chunk);
+      memset (game->chunk, 0, CHUNKS(game->WROWS) * game->chunk_cols * sizeof(char *));
+    }
+
+  for (i=0; i<game->nsnakes; i++)
+    {
+      game->snakes[i].positions = i ? positions + MAX_SNAKE_LENGTH + (i-1) * MAX_RIVAL_LENGTH : positions;
+      game->snakes[i].capacity = i ? MAX_RIVAL_LENGTH : MAX_SNAKE_LENGTH;
+      game->snakes[i].head_char = i ? RIVAL_HEAD : SNAKE_HEAD;
+      game->snakes[i].body_char = i ? RIVAL_BODY : SNAKE_BODY;
+      game->snakes[i].energy = 0;
+    }
+
+  game->snake->energy = (game->NCOLS + game->NROWS);
+  game->snake->alive = 1;
+  start_snake (game, game->snake);
+  lay_snake (game, scene, game->snake);
+
+  for (i=1; i<game->nsnakes; i++)
+    spawn_rival (game, scene, &game->snakes[i], RIVAL_TRIES);
+
+   /* Generate energy blocks away from the borders and the snakes */
+  for (i=0; i<game->max_energy_blocks; i++)
+    game->energy_block[i].x = BLOCK_INACTIVE;
+  for (i=0; i<game->max_energy_blocks; i++)
+    more_snacks (game, scene);
+
+  /* History starts now, and the controller (if any) sees a new board. */
+
+  forget(game);
+  controller_resync();
+
+  /* Set to zero elapsed_total when the player pressed pause */
+  game->elapsed_pause.tv_sec = 0;
+  game->elapsed_pause.tv_usec = 0;
+}
+
+/* Whether a snake crashes into a board cell holding c. Tails are left
+   out: a tail may move out of the way (see advance). */
+
+#define DEADLY(c) ((c) == SNAKE_BODY || (c) == SNAKE_HEAD \
+		   || (c) == RIVAL_BODY || (c) == RIVAL_HEAD)
+
+/* Steer an arena rival: go ahead, but now and then, or if that would be
+   deadly, turn to either side, whichever is safe. */
+
+void steer (game_t *game, scene_t* scene, snake_t *s)
+{
+  static const direction_t turns[4][2] = {
+    {left, right},		/* up */
+    {up, down},			/* right */
+    {down, up},			/* left */
+    {right, left}};		/* down */
+  direction_t options[3];
+  pair_t p;
+  int i, side;
+
+  side = rand() % 2;
+  options[0] = s->direction;
+  options[1] = turns[s->direction][side];
+  options[2] = turns[s->direction][!side];
+
+  if (rand() % 8 == 0)
+    {
+      options[0] = options[1];
+      options[1] = s->direction;
+    }
+
+  for (i=0; i<3; i++)
+    {
+      p = s->head;
+      p.x += options[i] == right ? 1 : options[i] == left ? -1 : 0;
+      p.y += options[i] == down ? 1 : options[i] == up ? -1 : 0;
+      if (p.x > 0 && p.x < game->WCOLS - 1 && p.y > 0 && p.y < game->WROWS - 1
+	  && !DEADLY(cell(game, scene, p.y, p.x)))
+	{
+	  s->direction = options[i];
+	  return;
+	}
+    }
+}
+
+/* Have the controller steer the player's snake, in place of the player
+   (see controller.h). It is shown the changes to the playfield since the
+   last step, as noted by board_set, unless these can't tell how the
+   playfield looks now (e.g. in the first step); then it is shown the
+   whole of it. Return -1 if the controller is gone. */
+
+int control (game_t *game, scene_t* scene)
+{
+  static obs_header_t header;
+  obs_block_t blocks[MAX_ENERGY_BLOCKS_LIMIT];
+  int i, y, x, answer;
+  uint64_t start = monotonic_usec();
+  char *c;
+
+  if (controller_resyncing ())
+    {
+      if (!world)
+	for (y=1; y<game->NROWS-1; y++)
+	  for (x=1; x<game->NCOLS-1; x++)
+	    if (scene[0][y][x] != BLANK)
+	      controller_cell (y, x, scene[0][y][x]);
+
+      /* In a large world, only chunks written may hold anything. */
+
+      for (i=0; world && i < CHUNKS(game->WROWS) * game->chunk_cols; i++)
+	{
+	  c = game->chunk[i];
+	  if (!c)
+	    continue;
+	  for (y=0; y<CHUNK; y++)
+	    for (x=0; x<CHUNK; x++)
+	      if (c[y << CHUNK_BITS | x] != BLANK)
+		controller_cell ((i / game->chunk_cols) << CHUNK_BITS | y,
+				 (i % game->chunk_cols) << CHUNK_BITS | x,
+				 c[y << CHUNK_BITS | x]);
+	}
+    }
+
+  header.nblocks = 0;
+  for (i=0; i<game->max_energy_blocks; i++)
+    if (game->energy_block[i].x != BLOCK_INACTIVE)
+      {
+	blocks[header.nblocks].y = game->energy_block[i].y;
+	blocks[header.nblocks].x = game->energy_block[i].x;
+	header.nblocks++;
+      }
+
+  header.energy = game->snake->energy;
+  header.rows = game->WROWS;
+  header.cols = game->WCOLS;
+  header.head_y = game->snake->head.y;
+  header.head_x = game->snake->head.x;
+  header.direction = game->snake->direction;
+
+  answer = controller_step (&header, blocks);
+  header.step++;
+  trace_span ("control", start);
+  if (answer < 0)
+    return -1;
+
+  /* As from the keyboard, the snake can't turn back onto itself: the
+     directions are numbered so that the opposite of d is 3 - d. */
+
+  if (answer <= CTL_DOWN && answer != 3 - (int) game->snake->lastdirection)
+    game->snake->direction = answer;
+  return 0;
+}
+
+/* This function advances the game. It computes the next state
+   and updates the scene vector. This is Tron's game logic.
+
+   All snakes move at once. Each step costs time proportional to the
+   number of snakes, whatever the size of the playfield: only the ends of
+   a snake change, cells are checked on the playfield itself, and
+   head-to-head crashes are found by having each head claim the cell it
+   moves into, in a small hash table of the cells claimed. The tails which
+   move out of the way in this step are noted likewise, and only these
+   may be entered. */
+
+#define CLAIM_HASH(p) (((unsigned int) (p).y * 40503u + (unsigned int) (p).x) % CLAIM_SLOTS)
+
+void advance (game_t *game, scene_t* scene)
+{
+	claim_t *claim = game->claim, *vacated = game->vacated;
+	unsigned int step;
+	snake_t *s;
+	pair_t head, tail;
+	int i, k;
+	unsigned int h;
+	char c;
+
+	if(game->player_lost)
+		return;
+
+	step = ++game->step;
+	remember(game, CH_STEP, 0, 0, game->snake->energy, game->block_count);
+
+	/* Lose energy at every step */
+    	game->snake->energy--;
+
+	/* Calculate next position of the heads, and have them claim the cells.
+	   Two heads claiming the same cell crash into each other. */
+	for(i = 0; i < game->nsnakes; i++){
+		s = &game->snakes[i];
+		s->crashed = 0;
+		if(!s->alive)
+			continue;
+		snake_save(game, s);
+		if(i > 0)
+			steer(game, scene, s);
+
+		head = s->head;
+		switch(s->direction){
+			case up:
+				head.y -= 1;
+				break;
+			case right:
+				head.x += 1;
+				break;
+			case left:
+				head.x -= 1;
+				break;
+			case down:
+				head.y += 1;
+				break;
+		}
+		s->next = head;
+		s->lastdirection = s->direction;
+
+		if(head.x <= 0 || head.x >= game->WCOLS - 1 || head.y <= 0 || head.y >= game->WROWS - 1)
+			continue;
+
+		h = CLAIM_HASH(head);
+		while(claim[h].step == step && (claim[h].cell.x != head.x || claim[h].cell.y != head.y))
+			h = (h + 1) % CLAIM_SLOTS;
+
+		if(claim[h].step == step){
+			s->crashed = 1;
+			game->snakes[claim[h].claimer].crashed = 1;
+		}
+		claim[h].step = step;
+		claim[h].cell = head;
+		claim[h].claimer = i;
+	}
+
+	/* Note the tails which move, i.e. those of the snakes which don't
+	   grow. A tail which stays is as deadly as the rest of the body. If
+	   its snake crashes, the snake leaves the board anyway. */
+	for(i = 0; i < game->nsnakes; i++){
+		s = &game->snakes[i];
+		if(!s->alive)
+			continue;
+		head = s->next;
+		if(   head.x > 0 && head.x < game->WCOLS - 1 && head.y > 0 && head.y < game->WROWS - 1
+		   && cell(game, scene, head.y, head.x) == ENERGY_BLOCK && s->length < s->capacity)
+			continue;
+
+		tail = PIECE(s, 0);
+		h = CLAIM_HASH(tail);
+		while(vacated[h].step == step)
+			h = (h + 1) % CLAIM_SLOTS;
+		vacated[h].step = step;
+		vacated[h].cell = tail;
+	}
+
+	/* Check if heads collided with border or a snake, or if energy is empty.
+	   When a head reaches an energy block, that snake eats it and grows,
+	   i.e. its tail stays, unless it's as long as it may get. */
+	for(i = 0; i < game->nsnakes; i++){
+		s = &game->snakes[i];
+		if(!s->alive)
+			continue;
+		head = s->next;
+
+		if(   head.x <= 0 || head.x >= game->WCOLS - 1
+		   || head.y <= 0 || head.y >= game->WROWS - 1
+		   || DEADLY(cell(game, scene, head.y, head.x))
+		   || (s == game->snake && game->snake->energy <= 0))
+			s->crashed = 1;
+
+		if(!s->crashed && cell(game, scene, head.y, head.x) == SNAKE_TAIL){
+			h = CLAIM_HASH(head);
+			while(vacated[h].step == step && (vacated[h].cell.x != head.x || vacated[h].cell.y != head.y))
+				h = (h + 1) % CLAIM_SLOTS;
+			if(vacated[h].step != step)
+				s->crashed = 1;
+		}
+
+		if(s->crashed)
+			continue;
+
+		c = cell(game, scene, head.y, head.x);
+		if(c == ENERGY_BLOCK){
+			/* The head position is the same as an energy block */
+			for(k = 0; k < game->max_energy_blocks; k++)
+				if(head.x == game->energy_block[k].x && head.y == game->energy_block[k].y)
+					block_set(game, k, BLOCK_INACTIVE, game->energy_block[k].y);
+
+			if(s == game->snake){
+				game->block_count += 1;
+				game->snake->energy += (game->NCOLS + game->NROWS) / 2 * (sqrt(2) / sqrt(game->max_energy_blocks + 1));
+				if(game->snake->energy > MAX_SNAKE_ENERGY){
+					game->snake->energy = MAX_SNAKE_ENERGY;
+				}
+			}
+		}
+
+		if(c != ENERGY_BLOCK || s->length == s->capacity){
+			/* Erase old position of the tail */
+			tail = PIECE(s, 0);
+			board_set(game, scene, tail.y, tail.x, BLANK);
+			s->tail = (s->tail + 1) % s->capacity;
+			s->length--;
+		}
+	}
+
+	if(game->snake->crashed){
+		game->player_lost = 1;
+		return;
+	}
+
+	/* Crashed rivals leave the board, before any head is drawn where
+	   their tails were, and come back elsewhere once all heads are. */
+	for(i = 0; i < game->nsnakes; i++)
+		if(game->snakes[i].alive && game->snakes[i].crashed)
+			clear_snake(game, scene, &game->snakes[i]);
+
+	/* Advance snakes in one step, now that all tails have moved. */
+	for(i = 0; i < game->nsnakes; i++){
+		s = &game->snakes[i];
+		if(!s->alive)
+			continue;
+
+		/* Draw new position of the body over the old head */
+		board_set(game, scene, s->head.y, s->head.x, s->body_char);
+
+		s->length++;
+		piece_set(game, s, s->length - 1, s->next);
+		s->head = s->next;
+
+		/* Draw new two position of the tail */
+		board_set(game, scene, PIECE(s, 0).y, PIECE(s, 0).x, SNAKE_TAIL);
+		board_set(game, scene, PIECE(s, 1).y, PIECE(s, 1).x, SNAKE_TAIL);
+		/* Draw new position of the head */
+		board_set(game, scene, s->head.y, s->head.x, s->head_char);
+	}
+
+	/* Rivals which crashed now come back; those left out before, for
+	   want of room, are tried a few more times at every step. */
+	for(i = 1; i < game->nsnakes; i++)
+		if(!game->snakes[i].alive)
+			spawn_rival(game, scene, &game->snakes[i],
+				    game->snakes[i].crashed ? RIVAL_TRIES : RESPAWN_TRIES);
+
+	/* Replace eaten blocks */
+	for(k = 0; k < game->max_energy_blocks; k++)
+		if(game->energy_block[k].x == BLOCK_INACTIVE)
+			more_snacks(game, scene);
+}
+
+/* Fit the board to the terminal. Query the terminal size, let ncurses know
+   about it, and resize and center the main window accordingly. Scenes are
+   kept at full size, so nothing needs to be read again. Return 0 if the
+   terminal is too small to hold the board, or 1 otherwise. */
+
+int layout (game_t *game)
+{
+  struct winsize ws;
+  int maxWidth, maxHeight, lines, top, left;
+
+  if (game->term)
+    {
+      /* Ncurses doesn't know a hosted game's terminal (see send_frame). */
+      if (ioctl (game->term->fd, TIOCGWINSZ, &ws) < 0)
+	ws.ws_row = ws.ws_col = 0;
+      maxHeight = ws.ws_row;
+      maxWidth = ws.ws_col;
+      game->sent.fresh = 1;
+    }
+  else
+    {
+      if (ioctl (STDOUT_FILENO, TIOCGWINSZ, &ws) == 0)
+	resizeterm (ws.ws_row, ws.ws_col);
+
+      getmaxyx(stdscr, maxHeight, maxWidth);
+      record_resize (maxHeight, maxWidth);
+    }
+
+  if ((maxHeight - LOWER_PANEL_ROWS < MIN_ROWS) || (maxWidth < MIN_COLS))
+    {
+      game->too_small = 1;
+      return 0;
+    }
+  game->too_small = 0;
+
+  /* Set game board size */
+  game->NROWS = hires ? (int) fmin(2 * (maxHeight - LOWER_PANEL_ROWS), SCENE_ROWS)
+    : (int) fmin(maxHeight - LOWER_PANEL_ROWS, TEXT_ROWS);
+  game->NCOLS = (int) fmin(maxWidth, SCENE_COLS);
+
+  /* The board is the playfield, or a view of a large world. */
+  if (world)
+    {
+      game->NROWS = (int) fmin(game->NROWS, game->WROWS);
+      game->NCOLS = (int) fmin(game->NCOLS, game->WCOLS);
+    }
+  else
+    {
+      game->WROWS = game->NROWS;
+      game->WCOLS = game->NCOLS;
+    }
+
+  lines = BOARD_LINES + LOWER_PANEL_ROWS;
+  top = (maxHeight - lines) / 2;
+  left = (maxWidth - game->NCOLS) / 2;
+  game->panel_top = -1;		/* The panel is drawn anew. */
+  grid_resize (&game->grid, lines, game->NCOLS);
+
+  if (game->term)
+    {
+      /* The grid is placed on the terminal as it's sent. */
+      game->sent.top = top;
+      game->sent.left = left;
+      return 1;
+    }
+
+  if (!game->main_window)
+    game->main_window = newwin(lines, game->NCOLS, top, left);
+  else
+    {
+      /* Move to the origin first, so that the window fits the screen
+	 at every step whether it grows or shrinks. */
+      mvwin(game->main_window, 0, 0);
+      wresize(game->main_window, lines, game->NCOLS);
+      mvwin(game->main_window, top, left);
+    }
+
+  clear();
+  refresh();
+  return 1;
+}
+
+/* Handle a pending terminal resize. If the board has shrunk, move whatever
+   was left outside of it back within the borders: snake pieces are clamped
+   to the nearest board cell and energy blocks are generated anew. */
+
+/* Whether row y, column x is off a board resized to NROWS x NCOLS, or
+   on its border. */
+
+int outside (game_t *game, int y, int x)
+{
+  return (x >= game->NCOLS - 1) || (y >= game->NROWS - 1);
+}
+
+/* Whether snake s lies on row y, column x. */
+
+int on_snake (snake_t *s, int y, int x)
+{
+  int i;
+
+  for (i=0; i<s->length; i++)
+    if ((PIECE(s, i).x == x) && (PIECE(s, i).y == y))
+      break;
+  return i < s->length;
+}
+
+void relayout (game_t *game, scene_t* scene)
+{
+  int i, k, relaid;
+
+  game->resized = 0;
+
+  if (!layout(game))
+    {
+      /* Nothing sensible to draw; tell the player and wait for another resize. */
+      if (game->term)
+	fprintf (game->term->out, ANSI_CLEAR "Terminal too small: need %d rows and %d columns.",
+		 MIN_ROWS + LOWER_PANEL_ROWS, MIN_COLS);
+      else
+	{
+	  clear();
+	  mvprintw(0, 0, "Terminal too small: need %d rows and %d columns.",
+		   MIN_ROWS + LOWER_PANEL_ROWS, MIN_COLS);
+	  refresh();
+	}
+      return;
+    }
+
+  if (!scene || !game->snake->positions)
+    return;
+
+  /* A large world doesn't change with the view. */
+
+  if (world)
+    {
+      if (game->snake->energy > MAX_SNAKE_ENERGY)
+	game->snake->energy = MAX_SNAKE_ENERGY;
+      return;
+    }
+
+  /* Whatever is left outside the board is taken off it and put back
+     within. The player's snake, if any of it is left outside, starts over
+     where a game starts; rivals and blocks in the way are moved too. */
+
+  for (i=0; i<game->snake->length; i++)
+    if (outside (game, PIECE(game->snake, i).y, PIECE(game->snake, i).x))
+      break;
+  relaid = i < game->snake->length;
+  if (relaid)
+    {
+      clear_snake (game, scene, game->snake);
+      game->snake->alive = 1;
+      start_snake (game, game->snake);
+    }
+
+  for (i=1; i<game->nsnakes; i++)
+    for (k=0; game->snakes[i].alive && k<game->snakes[i].length; k++)
+      if (outside (game, PIECE(&game->snakes[i], k).y, PIECE(&game->snakes[i], k).x)
+	  || (relaid && on_snake (game->snake, PIECE(&game->snakes[i], k).y,
+				  PIECE(&game->snakes[i], k).x)))
+	clear_snake (game, scene, &game->snakes[i]);
+
+  for (i=0; i<game->max_energy_blocks; i++)
+    if ((game->energy_block[i].x != BLOCK_INACTIVE)
+	&& (outside (game, game->energy_block[i].y, game->energy_block[i].x)
+	    || (relaid && on_snake (game->snake, game->energy_block[i].y,
+				    game->energy_block[i].x))))
+      {
+	board_set (game, scene, game->energy_block[i].y, game->energy_block[i].x, BLANK);
+	block_set (game, i, BLOCK_INACTIVE, 0);
+      }
+
+  if (relaid)
+    lay_snake (game, scene, game->snake);
+  for (i=1; i<game->nsnakes; i++)
+    if (!game->snakes[i].alive)
+      spawn_rival (game, scene, &game->snakes[i], RIVAL_TRIES);
+  for (i=0; i<game->max_energy_blocks; i++)
+    more_snacks (game, scene);
+
+  if (game->snake->energy > MAX_SNAKE_ENERGY)
+    game->snake->energy = MAX_SNAKE_ENERGY;
+
+  /* Pieces moved here can't be taken back, nor did the controller see
+     them move; history starts anew. */
 
+  forget(game);
+  controller_resync();
 }
 
+/* Sleep for usec microseconds, accounting for how much longer than that
+   it actually took. */
 
-/* Process user input.
-   This function runs in a separate thread. */
+void delay (int usec)
+{
+  struct timespec how_long;
+  uint64_t start, slept;
+
+  how_long.tv_sec = usec / 1000000;
+  how_long.tv_nsec = (usec % 1000000) * 1000L;
+
+  start = monotonic_usec();
+  nanosleep (&how_long, NULL);
+  slept = monotonic_usec() - start;
+
+  if (slept > (uint64_t) usec)
+    STAT_ADD (overshoot_usec, slept - usec);
+  STAT_ADD (sleeps, 1);
+  trace_span ("sleep", start);
+}
+
+/* Adapt the drawing rate to the terminal link after a frame was drawn,
+   which wrote bytes to the terminal while the link spent blocked usec
+   taking output.
 
-void * userinput()
+   Terminal output is queued (see output.c), so a slow link doesn't stall
+   the game loop by itself. Instead, the game keeps stepping at its own
+   pace and only draws one every frame_skip steps, so that the output stays
+   within FRAME_BYTE_BUDGET per step; whatever changed in between is merged
+   into the next frame drawn. If the link is blocked for a good share of
+   the step, frames are skipped twice as often; once it keeps up again,
+   the rate slowly recovers. */
+
+void pace_frame (game_t *game, uint64_t bytes, uint64_t blocked)
 {
-  int c;
-  while (1)
-  {
-    c = getchar();
+  int fit;
+
+  /* Steps needed to send this frame within budget. */
+
+  fit = (bytes + FRAME_BYTE_BUDGET - 1) / FRAME_BYTE_BUDGET;
+
+  if (blocked > (uint64_t) game->game_delay * game->frame_skip / 4)
+    game->frame_skip *= 2;
+  else if (game->frame_skip > fit)
+    game->frame_skip--;
+
+  if (game->frame_skip < fit)
+    game->frame_skip = fit;
+  if (game->frame_skip > MAX_FRAME_SKIP)
+    game->frame_skip = MAX_FRAME_SKIP;
+  if (game->frame_skip < 1)
+    game->frame_skip = 1;
+}
 
-    if(on_settings)
+/* This function plays the game introduction animation.
+
+   Frames are shown at their timestamps on a presentation clock, which the
+   player may move forth and back (see press). Frames whose time has
+   passed when the previous one is done are dropped, so that the movie
+   keeps real time, and each frame is only read from its file (into the
+   single scene given) when it is about to be shown, unless the whole
+   intro was read at once (intro_frames).
+
+   The intro is played a frame at a time: movie_start() starts the clock,
+   and movie_frame() shows the frame due, if not shown yet, and returns
+   when the next one is due, or 0 once the intro is over. */
+
+void movie_start (game_t *game)
+{
+  game->playing_movie = 1;
+  game->movie_origin = monotonic_usec();
+  game->movie_shown = -1;
+}
+
+uint64_t movie_frame (game_t *game, scene_t* scene, char *data_dir, int nscenes)
+{
+  int k, seeking;
+  uint64_t start, at;
+
+  if (!game->go_on)
     {
-      switch(c)
-      {
-        case 'p':
-          on_settings=0;
-          restart_game=1;
-        break;
-        case 'w':
-          which_setting -= 1;
-        break;
-        case 's':
-          which_setting += 1;
-        break;
-        case 'a':
-          if(which_setting == ST_MAX_ENERGY){
-            max_energy_blocks -= 1;
-          }
-        break;
-        case 'd':
-          if(which_setting == ST_MAX_ENERGY){
-            max_energy_blocks += 1;
-          }
-        break;
-        case 'q':
-          kill (0, SIGINT);	/* Quit. */
-        break;
-        default:
-        break;
-      }
+      game->playing_movie = 0;
+      return 0;
+    }
 
-      /* Checks validity of the settings */
-      if(which_setting < 0)
-        which_setting = 0;
+  if (game->resized)
+    {
+      relayout (game, NULL);
+      game->movie_shown = -1;			/* Draw the frame again. */
+    }
+  if (game->too_small)
+    return monotonic_usec() + MOVIE_FRAME_USEC; /* Wait for a resize. */
 
-      if(which_setting >= ST_COUNT)
-        which_setting = ST_COUNT - 1;
+  /* Find the frame due now, after moving the clock if asked to. */
 
-      if(max_energy_blocks < 1)
-        max_energy_blocks = 1;
+  at = monotonic_usec();
+  k = (at - game->movie_origin) / MOVIE_FRAME_USEC;
 
-      if(max_energy_blocks > MAX_ENERGY_BLOCKS_LIMIT)
-          max_energy_blocks = MAX_ENERGY_BLOCKS_LIMIT;
-    } else {
-      switch (c)
-      {
-      case '+':			/* Increase FPS. */
-        if(game_delay * (0.9) > MIN_GAME_DELAY)
-          game_delay *= (0.9);
+  seeking = game->movie_seek;
+  if (seeking)
+    {
+      k = (int) fmax(0, fmin(k + game->movie_seek, nscenes - 1));
+      game->movie_seek = 0;
+      game->movie_origin = at - (uint64_t) k * MOVIE_FRAME_USEC;
+    }
+
+  if (k >= nscenes)
+    {
+      game->playing_movie = 0;
+      return 0;
+    }
+
+  if (k != game->movie_shown)
+    {
+      if ((game->movie_shown >= 0) && (k > game->movie_shown + 1) && !seeking)
+	STAT_ADD (frames_skipped, k - game->movie_shown - 1); /* Dropped, late. */
+
+      start = monotonic_usec();
+      if (intro_frames)
+	scene = intro_frames + k;
+      else if (readscene (SCENE_DIR_INTRO, data_dir, k, *scene) < 0)
+	{
+	  endwin();
+	  sysfatal (1);
+	}
+      trace_span ("readscene", start);
+
+      showscene (game, scene, 0, 0);		       /* Show k-th scene. */
+      game->movie_shown = k;
+    }
+
+  return game->movie_origin + (uint64_t) (k + 1) * MOVIE_FRAME_USEC;
+}
+
+/* Play the intro, started with movie_start(). */
+
+void playmovie (game_t *game, scene_t* scene, char *data_dir, int nscenes)
+{
+  uint64_t due, at;
+
+  /* Sleep until the next frame is due. */
+
+  while ((due = movie_frame (game, scene, data_dir, nscenes)))
+    {
+      at = monotonic_usec();
+      if (due > at)
+	delay (due - at);
+    }
+}
+
+void draw_settings(game_t *game, scene_t *scene){
+  char buffer[SCENE_COLS];
+
+  sprintf(buffer, "%.15s %c %3d %c     Maximum number of blocks to display at the same time.",
+          "", game->which_setting == 0 ? '<' : ' ', game->max_energy_blocks, game->which_setting == 0 ? '>' : ' ');
+  memcpy(&scene[2][22][12], buffer, strlen(buffer));
+}
+
+
+/* Terminal output of the game, queued either by output.c or, if the game
+   is hosted, by the host: bytes not sent yet, bytes written so far, and
+   how long (usec) the terminal kept output waiting so far. */
+
+size_t out_pending (game_t *game)
+{
+  return game->term ? host_pending (game->term) : output_pending ();
+}
+
+size_t out_total (game_t *game)
+{
+  return game->term ? host_total (game->term) : output_total ();
+}
+
+uint64_t out_blocked (game_t *game)
+{
+  return game->term ? host_blocked (game->term) : STAT_GET (stats, write_block_usec);
+}
+
+/* Start the game on the given scenes, copied from the stock ones. */
+
+void game_start (game_t *game, scene_t* scene)
+{
+  memcpy (scene, stock_scene, N_GAME_SCENES * sizeof(scene_t));
+
+  game->go_on=!game->hung_up;
+  game->player_lost=0;
+  game->restart_game=0;
+  game->pause_game=0;
+  game->on_settings=1;
+
+  gettimeofday (&game->beginning, NULL);
+
+  init_game (game, scene);
+
+  /* User may change delay (game speedy) asynchronously. Game steps are
+     paced by their deadlines, not by the time it takes to draw them. */
+
+  game->deadline = monotonic_usec();
+  game->steps = 0;
+  game->blocked = out_blocked (game);
+}
+
+/* This function implements the gameplay loop, a step at a time: it takes
+   one game step, and returns when the next one is due, or 0 once the game
+   is over. */
+
+uint64_t game_step (game_t *game, scene_t* scene)
+{
+  uint64_t start;
+  int drawing;			/* Whether this step is drawn. */
+#ifdef ALLOC_CHECK
+  size_t allocs;		/* Heap calls before this step. */
+#endif
+
+  if (!game->go_on)
+    return 0;
+
+  if (game->resized)
+    {
+      relayout (game, scene);		      /* Fit board to terminal. */
+    }
+  if (game->too_small)
+    return monotonic_usec() + game->game_delay; /* Wait for a resize. */
+
+#ifdef ALLOC_CHECK
+  allocs = alloc_calls();
+#endif
+
+  /* Draw if it's time to, and the terminal has taken the last frame:
+     a terminal which takes nothing isn't drawn to, however long. */
+
+  drawing = (++game->steps >= game->frame_skip)
+    && (out_pending(game) <= FRAME_BYTE_BUDGET);
+
+  if (drawing)
+    game->bytes = out_total(game);
+
+  if(game->rewind_steps && !game->on_settings) {
+    /* Take back steps asked by the player, if any is left. */
+    start = monotonic_usec();
+    for (; game->rewind_steps > 0; game->rewind_steps--)
+      if (rewind_step (game, scene))
+        game->player_lost = 0;
+    controller_resync ();		      /* Show the controller the past. */
+    trace_span ("rewind", start);
+  } else if(!game->on_settings && !game->pause_game) {
+    if (controlled && !game->player_lost && control (game, scene) < 0)
+      game->go_on = 0;			      /* Controller is gone. */
+    start = monotonic_usec();
+    advance (game, scene);		               /* Advance game.*/
+    STAT_ADD (advance_usec, monotonic_usec() - start);
+    STAT_ADD (ticks, 1);
+    trace_span ("advance", start);
+  }
+
+  start = monotonic_usec();
+
+  if (game->on_settings) {
+    draw_settings(game, scene);
+  }
+
+  if(game->player_lost){
+    /* Write score on the scene */
+    char buffer[128];
+    sprintf(buffer, "%d", game->block_count);
+    memcpy(&scene[1][27][30], buffer, strlen(buffer));
+  }
+
+  trace_span ("compose", start);
+
+  if(game->restart_game) {
+    /* Reset variables as at the beginning of the game */
+    game->go_on=1;
+    game->player_lost=0;
+    game->restart_game=0;
+    game->pause_game=0;
+    gettimeofday (&game->beginning, NULL);
+
+    /* Start over from the pristine copy of the scenes. */
+    memcpy (scene, stock_scene, N_GAME_SCENES * sizeof(scene_t));
+    init_game (game, scene);
+  }
+
+  if (drawing) {
+    if (world)
+      render_view (game, scene);		      /* Bring the view up to date. */
+    showscene (game, scene, /* Show k-th scene. */
+      game->player_lost ? 1 : game->on_settings ? 2 : game->pause_game ? 3 : 0,
+      game->on_settings ? 0 : 1);
+
+    pace_frame (game, out_total(game) - game->bytes,
+		out_blocked(game) - game->blocked);
+    game->blocked = out_blocked(game);
+    game->steps = 0;
+  } else {
+    STAT_ADD (frames_skipped, 1);
+  }
+
+#ifdef ALLOC_CHECK
+  assert (alloc_calls() == allocs);	/* Steps don't touch the heap. */
+#endif
+
+  /* The next step is due a delay after this one's. If drawing made us
+     late, go on right away to catch up, unless we're too far behind. */
+
+  game->deadline += game->game_delay;
+  start = monotonic_usec();
+  if ((start > game->deadline)
+      && (start - game->deadline > (uint64_t) MAX_FRAME_SKIP * game->game_delay))
+    game->deadline = start;
+
+  return game->deadline;
+}
+
+void playgame (game_t *game, scene_t* scene)
+{
+  uint64_t due, at;
+
+  /* Sleep until the next step is due. */
+
+  while ((due = game_step (game, scene)))
+    {
+      at = monotonic_usec();
+      if (due > at)
+	delay (due - at);	      /* Apply delay. */
+    }
+}
+
+
+/* Interrupt the game, as the terminal's interrupt key would. A hosted
+   game shares the process with the others, and is interrupted alone. */
+
+void interrupt_game (game_t *game)
+{
+  if (game->term)
+    quit (game);
+  else
+    kill (0, SIGINT);
+}
+
+/* Process a key pressed by the player. */
+
+void press (game_t *game, int c)
+{
+  uint64_t start = monotonic_usec();
+
+  STAT_ADD (input_events, 1);
+
+  if(game->playing_movie)
+  {
+    switch(c)
+    {
+      case 'a':
+        game->movie_seek -= MOVIE_SEEK;	/* Seek back. */
+      break;
+      case 'd':
+        game->movie_seek += MOVIE_SEEK;	/* Seek forward. */
       break;
-      case '-':			/* Decrease FPS. */
-        if(game_delay * (1.1) < MAX_GAME_DELAY)
-          game_delay *= (1.1) ;
+      case 'e':
+        game->movie_seek += MOVIE_END;	/* Jump to the end. */
       break;
       case 'q':
-        kill (0, SIGINT);	/* Quit. */
+        interrupt_game (game);	/* Skip the intro. */
       break;
-      case 'r':
-        restart_game = 1;	/* Restart game. */
+      default:
       break;
+    }
+  } else if(game->on_settings)
+  {
+    switch(c)
+    {
       case 'p':
-        if (pause_game) {
-           /* set beginning to current time and resume game */ 
-          gettimeofday (&beginning, NULL);
-          pause_game = 0;
-        } else {
-          /* set elapsed_pause to elapsed_total when player press 'p' and pause the game */
-          memcpy (&elapsed_pause, &elapsed_total, sizeof (struct timeval));
-          pause_game = 1;
-        }
+        game->on_settings=0;
+        game->restart_game=1;
       break;
       case 'w':
-        if(snake.lastdirection != down){
-          snake.direction = up;
-        }
-      break;
-      case 'a':
-        if(snake.lastdirection != right){
-          snake.direction = left;
-        }
+        game->which_setting -= 1;
       break;
       case 's':
-        if(snake.lastdirection != up){
-          snake.direction = down;
+        game->which_setting += 1;
+      break;
+      case 'a':
+        if(game->which_setting == ST_MAX_ENERGY){
+          game->max_energy_blocks -= 1;
         }
       break;
       case 'd':
-        if(snake.lastdirection != left){
-          snake.direction = right;
+        if(game->which_setting == ST_MAX_ENERGY){
+          game->max_energy_blocks += 1;
         }
       break;
-      case 'h':
-        which_setting = 0;
-        on_settings = 1; /* Begin settings */
-
-        /* If player was dead (i.e. on the YOU LOSE screen), we reset it here. */
-        player_lost = 0;
-        break;
+      case 'q':
+        interrupt_game (game);	/* Quit. */
+      break;
       default:
       break;
+    }
+
+    /* Checks validity of the settings */
+    if(game->which_setting < 0)
+      game->which_setting = 0;
+
+    if(game->which_setting >= ST_COUNT)
+      game->which_setting = ST_COUNT - 1;
+
+    if(game->max_energy_blocks < 1)
+      game->max_energy_blocks = 1;
+
+    if(game->max_energy_blocks > MAX_ENERGY_BLOCKS_LIMIT)
+        game->max_energy_blocks = MAX_ENERGY_BLOCKS_LIMIT;
+  } else {
+    if (controlled && c && strchr ("wasd", c))
+      c = 0;			/* The controller steers instead. */
+
+    switch (c)
+    {
+    case '+':			/* Increase FPS. */
+      if(game->game_delay * (0.9) > MIN_GAME_DELAY)
+        game->game_delay *= (0.9);
+    break;
+    case '-':			/* Decrease FPS. */
+      if(game->game_delay * (1.1) < MAX_GAME_DELAY)
+        game->game_delay *= (1.1) ;
+    break;
+    case 'q':
+      interrupt_game (game);	/* Quit. */
+    break;
+    case 'r':
+      game->restart_game = 1;	/* Restart game. */
+    break;
+    case 'p':
+      if (game->pause_game) {
+         /* set beginning to current time and resume game */ 
+        gettimeofday (&game->beginning, NULL);
+        game->pause_game = 0;
+      } else {
+        /* set elapsed_pause to elapsed_total when player press 'p' and pause the game */
+        memcpy (&game->elapsed_pause, &game->elapsed_total, sizeof (struct timeval));
+        game->pause_game = 1;
+      }
+    break;
+    case 'w':
+      if(game->snake->lastdirection != down){
+        game->snake->direction = up;
+      }
+    break;
+    case 'a':
+      if(game->snake->lastdirection != right){
+        game->snake->direction = left;
+      }
+    break;
+    case 's':
+      if(game->snake->lastdirection != up){
+        game->snake->direction = down;
       }
+    break;
+    case 'd':
+      if(game->snake->lastdirection != left){
+        game->snake->direction = right;
+      }
+    break;
+    case 'z':
+      game->rewind_steps++;		/* Take back one step (hold to go on). */
+    break;
+    case 'h':
+      game->which_setting = 0;
+      game->on_settings = 1; /* Begin settings */
+
+      /* If player was dead (i.e. on the YOU LOSE screen), we reset it here. */
+      game->player_lost = 0;
+      break;
+    default:
+    break;
     }
   }
+
+  trace_span ("input", start);
+}
+
+/* Process user input to game g.
+   This function runs in a separate thread. */
+
+void * userinput(void *g)
+{
+  while (1)
+    press (g, getchar());
+  return NULL;
+}
+
+
+/* The games of a host (see host.h). Each is played a step at a time, as
+   the host calls. */
+
+void *session_open (host_term_t *term)
+{
+  game_t *game;
+
+  game = calloc (1, sizeof (game_t));
+  if (!game)
+    return NULL;
+
+  game_defaults (game);
+  game->term = term;
+  game->scenes = (scene_t *) malloc (N_GAME_SCENES * sizeof(scene_t));
+  if (!game->scenes || (game_memory (game) < 0))
+    goto fail;
+
+  /* The game draws on its grid, which layout sizes, and sends the
+     terminal what changed (see send_frame). Keys come to the game
+     through session_key. */
+
+  game->sent.cells = malloc (sizeof (cchar_t) * MAX_LINES * SCENE_COLS);
+  if (!game->sent.cells || (grid_open (&game->grid, MAX_LINES, SCENE_COLS) < 0))
+    goto fail;
+  fputs (ANSI_ENTER, term->out);
+
+  game->go_on = 1;			/* User may skip intro (q). */
+  game->resized = 1;			/* Fit the board to the terminal first. */
+  movie_start (game);
+  return game;
+
+ fail:
+  grid_close (&game->grid);
+  free (game->sent.cells);
+  free (game->scenes);
+  arena_free (&game->game_arena);
+  arena_free (&game->world_arena);
+  free (game);
   return NULL;
 }
 
+uint64_t session_play (void *g)
+{
+  game_t *game = g;
+  uint64_t due;
+
+  if (game->playing_movie)
+    {
+      due = movie_frame (game, NULL, NULL, intro_nscenes);
+      if (due)
+	return due;
+      game_start (game, game->scenes);
+    }
+
+  return game_step (game, game->scenes);
+}
+
+void session_key (void *g, int c)
+{
+  press (g, c);
+}
+
+void session_signal (void *g, int signum)
+{
+  game_signal (g, signum);
+}
+
+void session_close (void *g)
+{
+  game_t *game = g;
+
+  fputs (ANSI_LEAVE, game->term->out);
+
+  grid_close (&game->grid);
+  free (game->sent.cells);
+  free (game->scenes);
+  arena_free (&game->game_arena);
+  arena_free (&game->world_arena);
+  free (game);
+}
+
+const host_game_t hosted_game =
+  {session_open, session_play, session_key, session_signal, session_close};
+
 
 /* The main function. */
 
@@ -797,12 +2596,24 @@ int main(int argc, char **argv)
   const struct option stoptions[] = {
       {"data", required_argument, 0, 'd'},
       {"help", no_argument, 0, 'h'},
-      {"version", no_argument, 0, 'v'}};
+      {"version", no_argument, 0, 'v'},
+      {"trace", required_argument, 0, 't'},
+      {"arena", required_argument, 0, 'a'},
+      {"mono", no_argument, 0, 'm'},
+      {"hires", no_argument, 0, 'r'},
+      {"world", required_argument, 0, 'w'},
+      {"controller", required_argument, 0, 'c'},
+      {"record", required_argument, 0, 'R'},
+      {"host", required_argument, 0, 'H'},
+      {"join", required_argument, 0, 'J'},
+      {0, 0, 0, 0}};
 
   char currOpt;
+  char *controller_command = NULL;
+  char *host_path = NULL, *join_path = NULL;
 
   /* Handles options passed as arguments */
-  while ((currOpt = (getopt_long(argc, argv, "d:h:v", stoptions, NULL))) != -1)
+  while ((currOpt = (getopt_long(argc, argv, "d:h:vt:a:mrw:c:R:H:J:", stoptions, NULL))) != -1)
   {
     switch (currOpt)
     {
@@ -822,6 +2633,66 @@ int main(int argc, char **argv)
       exit (EXIT_SUCCESS);
       break;
 
+    case 'a':
+      /* Share the board with computer-controlled snakes */
+      arena_rivals = atoi(optarg);
+      if (arena_rivals < 0 || arena_rivals > MAX_RIVALS){
+        free(curr_data_dir);
+        show_help(true);
+      }
+      break;
+
+    case 'm':
+      /* Don't use colors */
+      monochrome = 1;
+      break;
+
+    case 'r':
+      /* Draw two board rows per terminal line */
+      hires = 1;
+      break;
+
+    case 'w':
+      /* Play in a world larger than the board */
+      world = sscanf(optarg, "%dx%d", &world_rows, &world_cols) == 2;
+      if (!world || world_rows < MIN_ROWS || world_cols < MIN_COLS
+          || world_rows > MAX_WORLD || world_cols > MAX_WORLD){
+        free(curr_data_dir);
+        show_help(true);
+      }
+      break;
+
+    case 'c':
+      /* Have a program steer the snake */
+      controller_command = optarg;
+      break;
+
+    case 'R':
+      /* Record the session as an asciicast, written as it goes */
+      if (record_open(optarg) < 0){
+        free(curr_data_dir);
+        sysfatal(1);
+      }
+      break;
+
+    case 'H':
+      /* Serve games to players who join */
+      host_path = optarg;
+      break;
+
+    case 'J':
+      /* Play on a host */
+      join_path = optarg;
+      break;
+
+    case 't':
+      /* Record frame phases, written to the given file at exit */
+      if (trace_open(optarg) < 0){
+        free(curr_data_dir);
+        sysfatal(1);
+      }
+      break;
+
     default:
       free(curr_data_dir);
       show_help(true);
@@ -831,89 +2702,195 @@ int main(int argc, char **argv)
   /* Outputs the data directory being used
   printf("%s\n", curr_data_dir); */
 
+  /* A player who joins a host only lends it the terminal. */
+
+  if (join_path){
+    free(curr_data_dir);
+    if (host_join(join_path) < 0){
+      perror(join_path);
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  /* Sessions of a host would all write the same files, and the
+     controller steers a single snake. */
+
+  if (host_path && (tracing || recording || controller_command)){
+    fprintf(stderr, "None of --trace, --record and --controller can be used with --host.\n");
+    return EXIT_FAILURE;
+  }
+
+  game_t *game = &solo;
   struct sigaction act;
+  FILE *nowhere;
   int rs;
-  int nscenes;
+  int nscenes = 0;
   pthread_t pthread;
   scene_t* intro_scene;
   scene_t* game_scene;
 
+  /* Half blocks are drawn as UTF-8. */
+
+  if (hires){
+    setlocale(LC_CTYPE, "");
+    if (strcmp(nl_langinfo(CODESET), "UTF-8")){
+      fprintf(stderr, "The hires mode needs a UTF-8 locale.\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* Games restart from the stock scenes. */
+
+  stock_scene = (scene_t *) malloc(sizeof(*stock_scene) * N_GAME_SCENES);
+  if(!stock_scene){
+    endwin();
+    sysfatal(!stock_scene);
+  }
+
+  init_pixels();
+
+  /* A host reads the scenes once, for all its games to share, and plays
+     them all on its threads (see session_open). */
+
+  if (host_path){
+    readscenes (SCENE_DIR_GAME, curr_data_dir, &stock_scene, N_GAME_SCENES);
+    intro_nscenes = readscenes (SCENE_DIR_INTRO, curr_data_dir, &intro_frames, 0);
+    host_share (stock_scene, N_GAME_SCENES * sizeof(scene_t));
+    host_share (intro_frames, intro_nscenes * sizeof(scene_t));
+
+    /* The games draw on grids of their own, and each sends its own
+       terminal what it drew (see send_frame). Ncurses only holds their
+       colors, on a screen it never shows, set up here once and only read
+       after, so that games may be played on many threads at once. The
+       screen's type only needs colors enough for the half blocks. */
+
+    nowhere = fopen("/dev/null", "r+");
+    if (!nowhere || !newterm("xterm-256color", nowhere, nowhere)){
+      fprintf(stderr, "Can't set up ncurses for the games.\n");
+      return EXIT_FAILURE;
+    }
+    init_colors();
+    init_halfblocks();
+
+    stats_open();
+
+    if (host_serve (host_path, &hosted_game) < 0){
+      perror(host_path);
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  game_defaults(game);
+
   game_scene = (scene_t *) malloc(sizeof(*game_scene) * N_GAME_SCENES);
   if(!game_scene){
     endwin();
     sysfatal(!game_scene);
   }
 
+  /* The game draws on a grid, shown on main_window (see show_frame). */
+
+  sysfatal (grid_open (&game->grid, MAX_LINES, SCENE_COLS) < 0);
+
+  /* Start the controller, before anything else it might inherit. */
+
+  if (controller_command)
+    sysfatal (controller_start (controller_command) < 0);
+
+  /* Publish performance counters for ttsnake-stat (best effort). */
+
+  stats_open();
+
+  /* Keep a slow terminal from blocking the game loop. */
+
+  output_start();
+
   /* Handle SIGNINT (loop control flag). */
 
   sigaction(SIGINT, NULL, &act);
-  act.sa_handler = quit;
+  act.sa_handler = on_signal;
   sigaction(SIGINT, &act, NULL);
 
-  /* Ncurses initialization. */
+  /* Handle SIGHUP and SIGTERM (e.g. the terminal is gone). */
+
+  act.sa_handler = on_signal;
+  sigaction(SIGHUP, &act, NULL);
+  sigaction(SIGTERM, &act, NULL);
 
-  initscr();
+  /* Handle SIGWINCH (terminal resize). Installed before ncurses so that it
+     takes precedence over the library's own handler; SA_RESTART keeps the
+     input thread's getchar() from failing when the signal hits it. */
+
+  sigaction(SIGWINCH, NULL, &act);
+  act.sa_handler = on_signal;
+  act.sa_flags |= SA_RESTART;
+  sigaction(SIGWINCH, &act, NULL);
+
+  /* Ncurses initialization. It writes to the output queue, if any. */
+
+  if(!newterm(NULL, output_stream(), stdin)){
+    fprintf(stderr, "Can't set up the terminal.\n");
+    return EXIT_FAILURE;
+  }
   noecho();
   curs_set(FALSE);
   cbreak();
+  init_colors();
+  init_halfblocks();
 
-  /* Get terminal size */
-  int maxWidth, maxHeight;
-  getmaxyx(stdscr, maxHeight, maxWidth);
-
-  /* Set game board size */
-  NROWS = (int) fmin(maxHeight - LOWER_PANEL_ROWS, 40);
-  NCOLS = (int) fmin(maxWidth, 90);
+  /* Set game board size from terminal size */
 
-  if(NROWS < 20 || NCOLS < 80){
+  if(!layout(game)){
     endwin();
-    fprintf(stderr, "You need a terminal with at least 20 rows and 80 columns to play.\n");
+    fprintf(stderr, "You need a terminal with at least %d rows and %d columns to play.\n",
+	    MIN_ROWS + LOWER_PANEL_ROWS, MIN_COLS);
     return EXIT_FAILURE;
   }
 
-  main_window = newwin(NROWS + LOWER_PANEL_ROWS, NCOLS,
-          (maxHeight - NROWS - LOWER_PANEL_ROWS) / 2, (maxWidth - NCOLS) / 2);
-  wrefresh(main_window);
-
-  /* Default values. */
+  wrefresh(game->main_window);
 
-  movie_delay = 2.5E4;	  /* Movie frame duration in usec (40usec) */
-  game_delay  = 9E4;	  /* Game frame duration in usec (4usec) */
-  max_energy_blocks = 3;
+  /* The intro is on before any key comes, so that a 'q' pressed at once
+     skips it rather than being lost. */
 
+  game->go_on=1;			/* User may skip intro (q). */
+  movie_start (game);
 
   /* Handle game controls in a different thread. */
 
-  rs = pthread_create (&pthread, NULL, userinput, NULL);
+  rs = pthread_create (&pthread, NULL, userinput, game);
   sysfatal (rs);
 
 
   /* Play intro. */
 
-  nscenes = readscenes (SCENE_DIR_INTRO, curr_data_dir, &intro_scene, 0);
+  /* Intro frames are read as they are played, one at a time. */
 
-  go_on=1;			/* User may skip intro (q). */
+  nscenes = countfiles (SCENE_DIR_INTRO, curr_data_dir);
+  intro_scene = (scene_t *) malloc(sizeof(*intro_scene));
+  if(!intro_scene){
+    endwin();
+    sysfatal(!intro_scene);
+  }
 
-  playmovie (intro_scene, nscenes);
+  playmovie (game, intro_scene, curr_data_dir, nscenes);
 
   /* Play game. */
 
-  readscenes (SCENE_DIR_GAME, curr_data_dir, &game_scene, N_GAME_SCENES);
-
-  go_on=1;
-  player_lost=0;
-  restart_game=0;
-  pause_game=0;
-  on_settings=1;
-
-  gettimeofday (&beginning, NULL);
+  readscenes (SCENE_DIR_GAME, curr_data_dir, &stock_scene, N_GAME_SCENES);
 
-  init_game (game_scene);
-  playgame (game_scene, curr_data_dir);
+  game_start (game, game_scene);
+  playgame (game, game_scene);
 
   endwin();
+  controller_stop();
   free(intro_scene);
   free(game_scene);
+  free(stock_scene);
+  arena_free(&game->game_arena);
+  arena_free(&game->world_arena);
+  grid_close(&game->grid);
   free(curr_data_dir);
 
   return EXIT_SUCCESS;
@@ -20,6 +20,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
 #include <sys/time.h>
 #include "../config.h"
 
@@ -70,6 +72,17 @@ timeval_add (struct timeval *result, struct timeval *x, struct timeval *y)
   }
 }
 
+/* Return the time in microseconds from an arbitrary, monotonic origin. */
+
+uint64_t
+monotonic_usec (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 /* Shows help screen. Exit code is -1 if isError is set to true */
 
 void show_help(char isError) {
@@ -79,6 +92,20 @@ Usage: " BIN_NAME " [options]\n\n\
   Options\n\n\
   -h, --help       Display this information message.\n\
   -d, --data       Selects a non-default data path\n\
-  -v, --version    Outputs the program version\n") ;
+  -v, --version    Outputs the program version\n\
+  -t, --trace FILE Write a Chrome trace of the frame phases to FILE at exit\n\
+  -a, --arena N    Share the board with N computer snakes (up to 500)\n\
+  -m, --mono       Don't use colors\n\
+  -r, --hires      Draw twice the board rows with Unicode half blocks\n\
+  -w, --world RxC  Play in a world of R rows and C cols (up to 10000),\n\
+                   larger than the board\n\
+  -c, --controller CMD\n\
+                   Have the program CMD steer the snake\n\
+  -R, --record FILE\n\
+                   Record the session to FILE, as an asciicast (asciinema)\n\
+  -H, --host SOCKET\n\
+                   Serve a game to every player who joins at SOCKET\n\
+  -J, --join SOCKET\n\
+                   Play on the host serving at SOCKET\n") ;
     exit(isError?-1:0) ;
 } 
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/time.h>
 
 /* Report a system error and exit. */
@@ -47,6 +48,11 @@ timeval_subtract (struct timeval *result, struct timeval *x, struct timeval *y);
 void
 timeval_add (struct timeval *result, struct timeval *x, struct timeval *y);
 
+/* Return the time in microseconds from an arbitrary, monotonic origin. */
+
+uint64_t
+monotonic_usec (void);
+
 /* Shows help screen. Exit code is -1 if isError is set to true */
 
 void show_help(char isError);